@@ -0,0 +1,174 @@
+// Throughput benchmark for the scoreboard engine.
+//
+//   cmake --build <dir> --target bench
+//   bench [--teams N] [--problems M] [--ops N] [--duration T] [--flush R]
+//         [--freeze R] [--scroll R] [--query R] [--seed S] [--threads N]
+//   bench ... --emit > input.txt     write the workload as judge input instead
+//
+// The command handlers are driven directly (no parsing), output goes to
+// /dev/null, and every operation is timed on its own so the report shows
+// per-command latency percentiles next to the overall rate. A run of SUBMITs
+// goes through a SubmitBatch as in the judge loop and is timed as a whole, so
+// the SUBMIT row counts runs.
+#include <bits/stdc++.h>
+#include <fcntl.h>
+#include "commands.h"
+#include "contest.h"
+#include "output_writer.h"
+#include "submit_batch.h"
+#include "worker_pool.h"
+#include "bench/workload.h"
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+long long elapsedNs(Clock::time_point a, Clock::time_point b) {
+    return chrono::duration_cast<chrono::nanoseconds>(b - a).count();
+}
+
+void runOp(Contest &contest, OutputWriter &out, const Workload &w, const WorkloadOp &op) {
+    const string &name = w.teamNames[op.team];
+    char pbuf[2];
+    switch (op.kind) {
+    case OpKind::Submit: // runs go through runSubmits
+        break;
+    case OpKind::Flush:
+        runFlush(contest, out);
+        break;
+    case OpKind::Freeze:
+        runFreeze(contest, out);
+        break;
+    case OpKind::Scroll:
+        runScroll(contest, out);
+        break;
+    case OpKind::QueryRanking:
+        runQueryRanking(contest, out, name);
+        break;
+    case OpKind::QuerySubmission:
+        runQuerySubmission(contest, out, name, problemFilter(op, pbuf), statusFilter(op));
+        break;
+    }
+}
+
+// Applies the run of SUBMITs that starts at w.ops[i] the way the judge loop
+// does; returns the index past the run
+size_t runSubmits(Contest &contest, SubmitBatch &batch, const Workload &w, size_t i) {
+    for (; i < w.ops.size() && w.ops[i].kind == OpKind::Submit; ++i) {
+        const WorkloadOp &op = w.ops[i];
+        batch.add(contest.findTeam(w.teamNames[op.team]), op.problem - 'A', (JudgeStatus)op.status, op.time);
+        if (batch.full()) applySubmits(contest, batch);
+    }
+    if (!batch.empty()) applySubmits(contest, batch);
+    return i;
+}
+
+// Nearest-rank percentile; sorts in place
+long long percentile(vector<long long> &v, double q) {
+    size_t k = (size_t)ceil(q * v.size());
+    k = k ? k - 1 : 0;
+    nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+void usage() {
+    fprintf(stderr, "usage: bench [--teams N] [--problems M] [--ops N] [--duration T] [--flush R]\n"
+                    "             [--freeze R] [--scroll R] [--query R] [--seed S] [--threads N] [--emit]\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    WorkloadConfig cfg;
+    int threads = 1;
+    bool emit = false;
+    for (int i = 1; i < argc; ++i) {
+        string_view arg = argv[i];
+        if (arg == "--emit") {
+            emit = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        const char *val = argv[++i];
+        if (arg == "--teams") cfg.teams = max(1, atoi(val));
+        else if (arg == "--problems") cfg.problems = min(kMaxProblems, max(1, atoi(val)));
+        else if (arg == "--ops") cfg.ops = max(0, atoi(val));
+        else if (arg == "--duration") cfg.duration = max(1, atoi(val));
+        else if (arg == "--flush") cfg.flushRatio = atof(val);
+        else if (arg == "--freeze") cfg.freezeRatio = atof(val);
+        else if (arg == "--scroll") cfg.scrollRatio = atof(val);
+        else if (arg == "--query") cfg.queryRatio = atof(val);
+        else if (arg == "--seed") cfg.seed = strtoull(val, nullptr, 10);
+        else if (arg == "--threads") threads = max(1, atoi(val));
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    Workload w = generateWorkload(cfg);
+    if (emit) {
+        OutputWriter out;
+        writeWorkload(w, out);
+        return 0;
+    }
+
+    int devnull = open("/dev/null", O_WRONLY);
+    if (devnull < 0) {
+        perror("/dev/null");
+        return 1;
+    }
+    WorkerPool pool(threads);
+    Contest contest;
+    if (threads > 1) contest.pool = &pool;
+
+    long long setupNs, totalNs;
+    vector<long long> latency[kOpKinds];
+    {
+        OutputWriter sink(devnull);
+        Clock::time_point t0 = Clock::now();
+        for (const string &name : w.teamNames) contest.addTeam(name);
+        contest.startContest(cfg.duration, cfg.problems);
+        Clock::time_point t1 = Clock::now();
+        setupNs = elapsedNs(t0, t1);
+
+        SubmitBatch submits;
+        Clock::time_point prev = t1;
+        for (size_t i = 0; i < w.ops.size();) {
+            const WorkloadOp &op = w.ops[i];
+            if (op.kind == OpKind::Submit) {
+                i = runSubmits(contest, submits, w, i);
+            } else {
+                runOp(contest, sink, w, op);
+                ++i;
+            }
+            Clock::time_point now = Clock::now();
+            latency[(int)op.kind].push_back(elapsedNs(prev, now));
+            prev = now;
+        }
+        sink.flush();
+        totalNs = elapsedNs(t1, Clock::now());
+    }
+    close(devnull);
+
+    printf("teams %d  problems %d  ops %zu  threads %d  seed %llu\n", cfg.teams, cfg.problems,
+           w.ops.size(), threads, (unsigned long long)cfg.seed);
+    printf("setup %.3f ms  run %.3f ms  %.0f ops/s\n", setupNs / 1e6, totalNs / 1e6,
+           totalNs ? w.ops.size() * 1e9 / totalNs : 0.0);
+    printf("%-17s %9s %11s %10s %10s %10s %10s\n", "command", "count", "total ms", "p50 us",
+           "p90 us", "p99 us", "max us");
+    for (int k = 0; k < kOpKinds; ++k) {
+        vector<long long> &v = latency[k];
+        if (v.empty()) continue;
+        long long sum = accumulate(v.begin(), v.end(), 0LL);
+        long long p50 = percentile(v, 0.50), p90 = percentile(v, 0.90), p99 = percentile(v, 0.99);
+        long long mx = *max_element(v.begin(), v.end());
+        printf("%-17s %9zu %11.3f %10.2f %10.2f %10.2f %10.2f\n", opKindName((OpKind)k), v.size(),
+               sum / 1e6, p50 / 1e3, p90 / 1e3, p99 / 1e3, mx / 1e3);
+    }
+    return 0;
+}
@@ -0,0 +1,429 @@
+#!/usr/bin/env python3
+"""Differential checks for the scoreboard engine.
+
+    cmake --build <dir> --target code bench
+    python3 bench/difftest.py <dir> [--seeds N] [--only check,...]
+
+Workloads come from `bench --emit`. Each check feeds them to `code`, with
+extra commands mixed in, and compares the replies with another run or with
+what the replies themselves imply:
+
+  modes    --threads and --ingest-threads print exactly what a plain run does
+  live     QUERY_LIVE_RANKING t answers what FLUSH then QUERY_RANKING t would
+  pages    PRINT TOP/RANGE/AROUND are slices of the board the next SCROLL prints
+  history  QUERY_RANKING t AT x is t's rank on the last board flushed by time x
+  diff     --board-diff boards, replayed onto the previous board, are the full
+           boards, and never repeat a row as it was last printed
+  restore  a run cut short, or killed with SIGKILL, and finished with
+           --restore prints what one run does, AT queries included, and
+           resumes right after the last input line it answered
+  multi    contests interleaved under --multi print what each does alone
+  damage   restoring from a damaged snapshot fails cleanly instead of crashing;
+           build code with -fsanitize=address to also catch stray reads
+
+A failing check writes its input to difftest-fail.txt and exits with 1.
+"""
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+SIZES = [(3, 400), (30, 3000), (200, 6000), (8, 1000)]  # (teams, ops) by seed % 4
+FAIL_FILE = "difftest-fail.txt"
+
+code = bench = ""
+scratch = ""
+
+
+def fail(check, seed, lines, why):
+    with open(FAIL_FILE, "w") as f:
+        f.write("\n".join(lines) + "\n")
+    print(f"{check}: FAIL seed {seed}: {why} (input in {FAIL_FILE})")
+    sys.exit(1)
+
+
+def workload(seed):
+    """bench --emit lines; the last one is END"""
+    teams, ops = SIZES[seed % 4]
+    duration = ops // 2 if seed % 2 else ops * 5  # odd seeds repeat times
+    args = [bench, "--emit", "--teams", teams, "--problems", 1 + seed * 7 % 26, "--ops", ops,
+            "--duration", duration, "--flush", 0.03, "--freeze", 0.01, "--scroll", 0.02,
+            "--query", 0.15, "--seed", seed]
+    out = subprocess.run([str(a) for a in args], capture_output=True, text=True, check=True).stdout
+    return out.splitlines()
+
+
+def team_names(lines):
+    return [l.split()[1] for l in lines if l.startswith("ADDTEAM ")]
+
+
+def problem_count(lines):
+    return int(next(l for l in lines if l.startswith("START ")).split()[4])
+
+
+def run(lines, *flags):
+    p = subprocess.run([code, *flags], input="\n".join(lines) + "\n", capture_output=True, text=True)
+    if p.returncode != 0:
+        raise RuntimeError(f"code {' '.join(flags)} exited with {p.returncode}: {p.stderr[-300:]}")
+    return p.stdout.splitlines()
+
+
+def replies(lines, out):
+    """The reply lines to each input line, [] for SUBMIT; every other command
+    replies with an [Info] or [Error] line and what follows it"""
+    groups = []
+    for l in out:
+        if l.startswith("[Info]") or l.startswith("[Error]") or not groups:
+            groups.append([])
+        groups[-1].append(l)
+    commands = sum(1 for l in lines if not l.startswith("SUBMIT "))
+    if commands != len(groups):
+        raise RuntimeError(f"{commands} commands but {len(groups)} replies")
+    groups.reverse()
+    return [[] if l.startswith("SUBMIT ") else groups.pop() for l in lines]
+
+
+def check_modes(seed):
+    lines = workload(seed)
+    want = run(lines)
+    for flags in (["--threads", "4"], ["--ingest-threads", "2"], ["--threads", "2", "--ingest-threads", "3"]):
+        if run(lines, *flags) != want:
+            fail("modes", seed, lines, " ".join(flags) + " differs from a plain run")
+
+
+def check_live(seed):
+    r = random.Random(seed)
+    base = workload(seed)
+    teams = team_names(base)
+    live, flushed, asked = [], [], []  # asked: where flushed has the added QUERY_RANKINGs
+    started = False
+    for l in base:
+        live.append(l)
+        flushed.append(l)
+        started = started or l.startswith("START ")
+        if started and l != "END" and r.random() < 0.15:
+            t = r.choice(teams)
+            live.append("QUERY_LIVE_RANKING " + t)
+            flushed += ["FLUSH", "QUERY_RANKING " + t]
+            asked.append(len(flushed) - 1)
+    got = [g[-1].replace(" LIVE ", " ") for l, g in zip(live, replies(live, run(live)))
+           if l.startswith("QUERY_LIVE_RANKING ")]
+    answers = replies(flushed, run(flushed))
+    want = [answers[i][-1] for i in asked]
+    if got != want:
+        fail("live", seed, live, "a live rank differs from FLUSH + QUERY_RANKING")
+
+
+def check_pages(seed):
+    r = random.Random(seed)
+    base = workload(seed)
+    teams = team_names(base)
+    n = len(teams)
+    lines = []
+    for l in base:
+        if l == "SCROLL":
+            t = r.choice(teams)
+            lines += ["FLUSH", f"PRINT TOP {n + r.randint(-1, 1)}",
+                      f"PRINT RANGE {r.randint(-1, n + 1)} {r.randint(0, n + 2)}",
+                      f"PRINT AROUND {t} {r.randint(0, 3)}", "QUERY_RANKING " + t]
+        lines.append(l)
+    answers = replies(lines, run(lines))
+    for i, l in enumerate(lines):
+        if not l.startswith("PRINT TOP "):
+            continue
+        board = answers[i + 4][1:1 + n]  # SCROLL, right after a FLUSH: its first board
+        k = int(l.split()[2])
+        a, b = map(int, lines[i + 1].split()[2:])
+        around = int(lines[i + 2].split()[3])
+        rank = int(answers[i + 3][-1].split()[-1])
+        want = [board[:k], board[max(a, 1) - 1:max(b, 0)], board[max(rank - around, 1) - 1:rank + around]]
+        got = [answers[i][1:], answers[i + 1][1:], answers[i + 2][1:]]
+        if got != want:
+            fail("pages", seed, lines, f"a page at line {i + 1} is not a slice of the board")
+
+
+def check_history(seed):
+    r = random.Random(seed)
+    base = workload(seed)
+    teams = team_names(base)
+    # expect: ("board", clock, frozen) after START/FLUSH/SCROLL, ("freeze", clock)
+    # or ("at", team, x)
+    lines, expect = [], []
+    clock, started, frozen = 0, False, False
+    for l in base:
+        if l == "END":
+            break
+        if l.startswith("QUERY_RANKING "):
+            continue  # only the ones added here are read back
+        lines.append(l)
+        if l.startswith("SUBMIT "):
+            clock = max(clock, int(l.split()[7]))
+        started = started or l.startswith("START ")
+        if l == "FREEZE":  # the workload freezes only while not frozen
+            frozen = True
+            expect.append(("freeze", clock))
+        if l == "SCROLL":
+            frozen = False
+        if l.startswith("START ") or l in ("FLUSH", "SCROLL"):
+            lines += ["QUERY_RANKING " + t for t in teams]
+            expect.append(("board", clock, frozen))
+        if started and r.random() < 0.1:
+            t, x = r.choice(teams), r.randint(0, clock + 50)
+            lines.append(f"QUERY_RANKING {t} AT {x}")
+            expect.append(("at", t, x))
+    lines.append("END")
+    answers = iter(g for l, g in zip(lines, replies(lines, run(lines, "--rank-history")))
+                   if l.startswith("QUERY_RANKING "))
+    boards, states = [], []  # (clock, {team: rank}), (clock, frozen)
+    for e in expect:
+        if e[0] == "board":
+            boards.append((e[1], dict(next(answers)[-1].split(" NOW AT RANKING ") for _ in teams)))
+            states.append((e[1], e[2]))
+            continue
+        if e[0] == "freeze":
+            states.append((e[1], True))
+            continue
+        _, t, x = e
+        seen = [ranks for c, ranks in boards if c <= x]
+        if not seen:
+            want = ["[Error]Query ranking failed: no ranking recorded at that time."]
+        else:
+            want = ["[Info]Complete query ranking."]
+            if [f for c, f in states if c <= x][-1]:
+                want.append("[Warning]Scoreboard was frozen at that time. The ranking may be inaccurate.")
+            want.append(f"{t} WAS AT RANKING {seen[-1][t]} AT {x}")
+        got = next(answers)
+        if got != want:
+            fail("history", seed, lines, f"QUERY_RANKING {t} AT {x}: got {got}, want {want}")
+
+
+def scroll_boards(out, m):
+    """Per SCROLL, its board rows before and after the rank-change lines.
+    Without change lines the two boards run together; then they all come as
+    `after` and `before` is None."""
+    for i, l in enumerate(out):
+        if l != "[Info]Scroll scoreboard.":
+            continue
+        before, after, changes = [], [], False
+        for row in out[i + 1:]:
+            if row.startswith("["):
+                break
+            if len(row.split()) != m + 4:
+                changes = True
+            else:
+                (after if changes else before).append(row)
+        yield (before, after) if changes else (None, before)
+
+
+def check_diff(seed):
+    lines = workload(seed)
+    m = problem_count(lines)
+    state, boards = {}, 0
+    full, diff = scroll_boards(run(lines), m), scroll_boards(run(lines, "--board-diff"), m)
+    for (fb0, fb1), (db0, db1) in zip(full, diff):
+        if fb0 is None:  # both runs together: check only the board after
+            fb1 = fb1[len(fb1) // 2:]
+        for rows, want in ((db0 or [], fb0), (db1, fb1)):
+            for row in rows:
+                name, rest = row.split(" ", 1)
+                if state.get(name) == rest:
+                    fail("diff", seed, lines, "repeated row " + row)
+                state[name] = rest
+            if want is None:
+                continue
+            boards += 1
+            got = [n + " " + rest for n, rest in sorted(state.items(), key=lambda x: int(x[1].split()[0]))]
+            if got != want:
+                fail("diff", seed, lines, f"board {boards} does not replay to the full board")
+
+
+def restore(lines, *flags):
+    """Replies of a --restore run fed lines, and the input line it resumed at"""
+    p = subprocess.run([code, *flags, "--restore"], input="".join(l + "\n" for l in lines),
+                       capture_output=True, text=True)
+    m = re.search(r"through input line (\d+)", p.stderr)
+    if p.returncode != 0 or not m:
+        raise RuntimeError(f"--restore exited with {p.returncode}: {p.stderr[-300:]}")
+    return p.stdout.splitlines(), int(m.group(1))
+
+
+def killed(lines, flags, wait_for, journal):
+    """Feeds lines to code without closing its input, reads wait_for reply
+    lines (or, when wait_for is None, lets it run for up to 20 ms once its
+    journal is started) and kills it with SIGKILL; returns the replies read"""
+    p = subprocess.Popen([code, *flags], stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True)
+    def feed():
+        try:
+            p.stdin.write("".join(l + "\n" for l in lines))
+            p.stdin.flush()
+        except BrokenPipeError:
+            pass
+    feeder = threading.Thread(target=feed)
+    feeder.start()
+    watchdog = threading.Timer(30, p.kill)
+    watchdog.start()
+    if wait_for is None:
+        while p.poll() is None and (not os.path.exists(journal) or os.path.getsize(journal) < 8):
+            time.sleep(0.001)
+        time.sleep(random.random() * 0.02)
+        p.kill()
+        out = p.stdout.read().splitlines()
+    else:
+        out = [p.stdout.readline().rstrip("\n") for _ in range(wait_for)]
+        p.kill()
+    watchdog.cancel()
+    p.wait()
+    feeder.join()
+    p.stdin.close()
+    p.stdout.close()
+    return out
+
+
+def check_restore(seed):
+    r = random.Random(seed)
+    base = workload(seed)
+    teams = team_names(base)
+    start = next(i for i, l in enumerate(base) if l.startswith("START "))
+    # cut after a command that replies, so a run killed once it has read
+    # every reply before the cut has journaled every line before it
+    cut = 1 + r.choice([i for i, l in enumerate(base) if not l.startswith("SUBMIT ")])
+    # before the cut anything; after it only times the restored history holds
+    crash_clock = max([0] + [int(l.split()[7]) for l in base[:cut] if l.startswith("SUBMIT ")])
+    lines, clock, split = [], 0, len(base)
+    for i, l in enumerate(base):
+        if i == cut:
+            split = len(lines)
+        lines.append(l)
+        if l.startswith("SUBMIT "):
+            clock = max(clock, int(l.split()[7]))
+        if start <= i and l != "END" and r.random() < 0.05:
+            lo = 0 if i < cut else crash_clock
+            lines.append(f"QUERY_RANKING {r.choice(teams)} AT {r.randint(lo, max(lo, clock) + 50)}")
+    want = run(lines, "--rank-history")
+    answers = replies(lines, want)
+    journal, snapshot = os.path.join(scratch, "journal"), os.path.join(scratch, "snapshot")
+
+    def fresh():
+        for path in (journal, snapshot):
+            if os.path.exists(path):
+                os.remove(path)
+
+    def resume(first, flags, how):
+        rest, at = restore(lines[split:], *flags)
+        if at != split:
+            fail("restore", seed, lines, f"{how} at line {split + 1}, resumed at line {at + 1}")
+        if first + rest != want:
+            fail("restore", seed, lines, f"{how} at line {split + 1} differs")
+
+    for every in (1, 7, 97, 10 ** 9):
+        flags = ["--rank-history", "--journal", journal, "--snapshot", snapshot]
+        fresh()
+        resume(run(lines[:split], *flags, "--snapshot-every", str(every)), flags, f"snapshot every {every}, cut")
+        fresh()
+        first = killed(lines[:split], flags + ["--snapshot-every", str(every)],
+                       sum(len(g) for g in answers[:split]), journal)
+        resume(first, flags, f"snapshot every {every}, killed")
+
+    # killed at any moment: the restart resumes after the last line journaled,
+    # the killed run replied to no line past it, and the restart answers the
+    # rest as one run does
+    base = base[:-1]  # without END, so it keeps waiting for input
+    flags = ["--journal", journal, "--snapshot", snapshot, "--snapshot-every", "7"]
+    fresh()
+    first = "\n".join(killed(base, flags, None, journal))
+    groups = replies(base + ["END"], run(base + ["END"]))
+    _, at = restore([], *flags)
+    if not "\n".join(l for g in groups[:at] for l in g).startswith(first):
+        fail("restore", seed, base, f"killed run replied past input line {at + 1}, where it resumes")
+    rest, again = restore(base[at:] + ["END"], *flags)
+    if again != at or rest != [l for g in groups[at:] for l in g]:
+        fail("restore", seed, base, f"killed at random, resumed at line {at + 1} and differs")
+
+
+def check_multi(seed):
+    r = random.Random(seed)
+    contests = [workload(seed + k * 1000) for k in range(3)]
+    streams = [[f"c{k} {l}" for l in lines] for k, lines in enumerate(contests)]
+    mixed, at = [], [0] * len(streams)
+    while any(at[k] < len(s) for k, s in enumerate(streams)):
+        k = r.choice([k for k, s in enumerate(streams) if at[k] < len(s)])
+        n = r.randint(1, 50)
+        mixed += streams[k][at[k]:at[k] + n]
+        at[k] += n
+    per = {}
+    for l in run(mixed, "--multi", "2"):
+        cid, _, rest = l.partition(" ")
+        per.setdefault(cid, []).append(rest)
+    for k, lines in enumerate(contests):
+        if per.get(f"c{k}") != run(lines):
+            fail("multi", seed, mixed, f"contest c{k} differs from running it alone")
+
+
+def check_damage(seed):
+    r = random.Random(seed)
+    lines = workload(seed)
+    journal, snapshot = os.path.join(scratch, "journal"), os.path.join(scratch, "snapshot")
+    for path in (journal, snapshot):
+        if os.path.exists(path):
+            os.remove(path)
+    run(lines[:-1], "--journal", journal, "--snapshot", snapshot, "--snapshot-every", str(len(lines) // 3))
+    data = open(snapshot, "rb").read()
+    for trial in range(20):
+        damaged = bytearray(data)
+        for _ in range(r.randint(1, 4)):
+            damaged[r.randrange(len(damaged))] = r.randrange(256)
+        with open(snapshot + ".bad", "wb") as f:
+            f.write(damaged)
+        shutil.copy(journal, journal + ".bad")
+        p = subprocess.run([code, "--rank-history", "--journal", journal + ".bad", "--snapshot", snapshot + ".bad",
+                            "--restore"], input="FLUSH\nFREEZE\nSCROLL\nEND\n", capture_output=True, text=True,
+                           errors="replace")
+        if p.returncode not in (0, 1) or "AddressSanitizer" in p.stderr:
+            fail("damage", seed, lines, f"trial {trial}: restore exited with {p.returncode}: {p.stderr[-300:]}")
+
+
+CHECKS = {
+    "modes": check_modes,
+    "live": check_live,
+    "pages": check_pages,
+    "history": check_history,
+    "diff": check_diff,
+    "restore": check_restore,
+    "multi": check_multi,
+    "damage": check_damage,
+}
+
+
+def main():
+    global code, bench, scratch
+    args = sys.argv[1:]
+    if not args or args[0].startswith("-"):
+        print(__doc__.strip())
+        return 2
+    code, bench = os.path.join(args[0], "code"), os.path.join(args[0], "bench")
+    seeds, only = 12, list(CHECKS)
+    i = 1
+    while i + 1 < len(args):
+        if args[i] == "--seeds":
+            seeds = int(args[i + 1])
+        elif args[i] == "--only":
+            only = args[i + 1].split(",")
+        i += 2
+    with tempfile.TemporaryDirectory() as scratch:
+        for name in only:
+            for seed in range(1, seeds + 1):
+                try:
+                    CHECKS[name](seed)
+                except RuntimeError as e:
+                    fail(name, seed, [], str(e))
+            print(f"{name}: ok ({seeds} seeds)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include "contest_types.h"
+#include "output_writer.h"
+using namespace std;
+
+// Synthetic contest: a roster of teams, START, then a stream of operations
+// drawn by the configured ratios (whatever is left over is SUBMIT). Times
+// rise evenly from 1 to the duration across the stream.
+struct WorkloadConfig {
+    int teams = 10000;
+    int problems = 26;
+    int ops = 300000;
+    int duration = 100000;
+    double flushRatio = 0.003;
+    double freezeRatio = 0.0001; // FREEZE is only drawn while not frozen
+    double scrollRatio = 0.0001; // SCROLL is only drawn while frozen
+    double queryRatio = 0.2; // split evenly between the two query commands
+    uint64_t seed = 1;
+};
+
+enum class OpKind : uint8_t {
+    Submit,
+    Flush,
+    Freeze,
+    Scroll,
+    QueryRanking,
+    QuerySubmission
+};
+
+constexpr int kOpKinds = 6;
+
+inline const char *opKindName(OpKind k) {
+    static const char *const names[kOpKinds] = {
+        "SUBMIT", "FLUSH", "FREEZE", "SCROLL", "QUERY_RANKING", "QUERY_SUBMISSION"
+    };
+    return names[(int)k];
+}
+
+struct WorkloadOp {
+    OpKind kind;
+    char problem; // 'A'.., or 0 for PROBLEM=ALL in a submission query
+    uint8_t status; // JudgeStatus, or kJudgeStatusCount for STATUS=ALL
+    int team;
+    int time;
+};
+
+struct Workload {
+    WorkloadConfig config;
+    vector<string> teamNames;
+    vector<WorkloadOp> ops; // a trailing SCROLL is added if the stream ends frozen
+};
+
+inline Workload generateWorkload(const WorkloadConfig &cfg) {
+    Workload w;
+    w.config = cfg;
+    mt19937_64 rng(cfg.seed);
+    auto uniform = [&]{ return (double)(rng() >> 11) * (1.0 / 9007199254740992.0); };
+
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+    w.teamNames.reserve(cfg.teams);
+    for (int i = 0; i < cfg.teams; ++i) {
+        // random prefix so name order is unrelated to insertion order; the
+        // index suffix keeps names unique within the 20-character limit
+        string name;
+        for (int k = 0; k < 6; ++k) name += alphabet[rng() % (sizeof(alphabet) - 1)];
+        name += '_';
+        name += to_string(i);
+        w.teamNames.push_back(move(name));
+    }
+
+    bool frozen = false;
+    w.ops.reserve((size_t)cfg.ops + 1);
+    for (int i = 0; i < cfg.ops; ++i) {
+        WorkloadOp op{OpKind::Submit, 0, 0, (int)(rng() % cfg.teams),
+                      1 + (int)((long long)i * (cfg.duration - 1) / max(1, cfg.ops))};
+        double x = uniform();
+        if ((x -= cfg.flushRatio) < 0) {
+            op.kind = OpKind::Flush;
+        } else if ((x -= cfg.freezeRatio) < 0) {
+            if (!frozen) op.kind = OpKind::Freeze;
+        } else if ((x -= cfg.scrollRatio) < 0) {
+            if (frozen) op.kind = OpKind::Scroll;
+        } else if ((x -= cfg.queryRatio) < 0) {
+            op.kind = rng() & 1 ? OpKind::QueryRanking : OpKind::QuerySubmission;
+        }
+        if (op.kind == OpKind::Freeze) frozen = true;
+        if (op.kind == OpKind::Scroll) frozen = false;
+        if (op.kind == OpKind::Submit) {
+            op.problem = char('A' + rng() % cfg.problems);
+            op.status = (uint8_t)(rng() % kJudgeStatusCount);
+        } else if (op.kind == OpKind::QuerySubmission) {
+            op.problem = rng() % 3 ? char('A' + rng() % cfg.problems) : 0;
+            op.status = (uint8_t)(rng() % (kJudgeStatusCount + 1));
+        }
+        w.ops.push_back(op);
+    }
+    if (frozen) w.ops.push_back(WorkloadOp{OpKind::Scroll, 0, 0, 0, cfg.duration});
+    return w;
+}
+
+inline string_view problemFilter(const WorkloadOp &op, char (&buf)[2]) {
+    if (!op.problem) return "ALL";
+    buf[0] = op.problem;
+    buf[1] = 0;
+    return string_view(buf, 1);
+}
+
+inline string_view statusFilter(const WorkloadOp &op) {
+    return op.status == kJudgeStatusCount ? string_view("ALL") : judgeStatusName((JudgeStatus)op.status);
+}
+
+// The workload as judge input, ending with END
+inline void writeWorkload(const Workload &w, OutputWriter &out) {
+    for (const string &name : w.teamNames) out << "ADDTEAM " << name << '\n';
+    out << "START DURATION " << w.config.duration << " PROBLEM " << w.config.problems << '\n';
+    for (const WorkloadOp &op : w.ops) {
+        const string &name = w.teamNames[op.team];
+        char pbuf[2];
+        switch (op.kind) {
+        case OpKind::Submit:
+            out << "SUBMIT " << op.problem << " BY " << name << " WITH "
+                << judgeStatusName((JudgeStatus)op.status) << " AT " << op.time << '\n';
+            break;
+        case OpKind::QueryRanking:
+            out << "QUERY_RANKING " << name << '\n';
+            break;
+        case OpKind::QuerySubmission:
+            out << "QUERY_SUBMISSION " << name << " WHERE PROBLEM=" << problemFilter(op, pbuf)
+                << " AND STATUS=" << statusFilter(op) << '\n';
+            break;
+        default:
+            out << opKindName(op.kind) << '\n';
+            break;
+        }
+    }
+    out << "END\n";
+}
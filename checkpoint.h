@@ -0,0 +1,628 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "contest.h"
+#include "contest_types.h"
+#include "output_writer.h"
+using namespace std;
+
+// Crash recovery: a binary journal of every state-changing command plus
+// periodic snapshots of the whole Contest. A restart loads the snapshot and
+// replays only the journal records written after it.
+//
+// Journal: the magic "SBJRNL01", then records of a tag byte and a payload:
+//   ADDTEAM  name length (u8) + name bytes
+//   START    duration (u32) + problem count (u8)
+//   SUBMIT   7 bytes: team (24 bits) | problem (5) | status (2) | time (21)
+//   FLUSH, FREEZE, SCROLL  no payload
+//   LINES    input lines applied so far (u64)
+// FREEZE and SCROLL are logged even when they fail; replay applies the same
+// checks, so records carry no results. The driver syncs the journal with a
+// LINES record before it writes any reply and before it waits for input, so
+// a reply never reaches the reader ahead of the events it follows. Replay
+// stops at the last LINES record, which tells a restart where to resume its
+// input; the events after it are dropped and their lines fed again.
+//
+// Snapshot: a header, a section table and 64-byte aligned raw arrays, so a
+// restart maps the file and copies each section straight into its column.
+// One is taken only right after a sync.
+
+constexpr char kJournalMagic[8] = {'S', 'B', 'J', 'R', 'N', 'L', '0', '1'};
+constexpr char kSnapshotMagic[8] = {'S', 'B', 'S', 'N', 'A', 'P', '0', '2'};
+constexpr int kJournalTeamBits = 24;
+
+enum class JournalTag : uint8_t {
+    AddTeam = 1,
+    Start,
+    Submit,
+    Flush,
+    Freeze,
+    Scroll,
+    Lines
+};
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() {
+        if (size) munmap((void *)data, size);
+    }
+
+    bool open(const string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        if (ok && st.st_size > 0) {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = p != MAP_FAILED;
+            if (ok) {
+                data = (const char *)p;
+                size = (size_t)st.st_size;
+            }
+        }
+        close(fd);
+        return ok;
+    }
+
+    const char *data = "";
+    size_t size = 0;
+};
+
+// ---------------- Snapshot ----------------
+
+enum SnapshotSection {
+    kNameChars,
+    kNameOffsets,
+    kNameSlots,
+    kNameOrdinal,
+    kSolvedMask,
+    kFirstAcceptedTime,
+    kWrongBeforeFirstAccepted,
+    kFrozenMask,
+    kTeamFreezeEpoch,
+    kFreezeSlot,
+    kFreezeActiveTeams,
+    kFreezeCells,
+    kQueryHead,
+    kQueryProblems,
+    kQueryRows,
+    kLastFlushedOrder,
+    kCachedKeys,
+    kKeyDirty,
+    kDirtyTeams,
+    kSnapshotSections
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint64_t journalOffset; // journal bytes already reflected in the snapshot
+    uint64_t inputLines; // input lines applied, as in the LINES record before journalOffset
+    uint32_t sectionCount;
+    uint32_t freezeEpoch;
+    int32_t started;
+    int32_t duration;
+    int32_t problemCount;
+    int32_t isFrozen;
+    int32_t teamCount;
+    int32_t queryRowsUsed;
+};
+
+struct SnapshotSectionEntry {
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+constexpr size_t kSnapshotAlign = 64;
+
+// Writes path.tmp and renames it over path, so a crash while saving leaves
+// the previous snapshot intact
+inline bool saveSnapshot(const Contest &c, const string &path, uint64_t journalOffset, uint64_t inputLines) {
+    // Each section is one or more contiguous pieces
+    vector<vector<pair<const void *, size_t>>> pieces(kSnapshotSections);
+    auto add = [&](int s, const auto &v){ pieces[s].emplace_back(v.data(), v.size() * sizeof(v[0])); };
+    add(kNameChars, c.teamNames.arena());
+    add(kNameOffsets, c.teamNames.arenaOffsets());
+    add(kNameSlots, c.teamNames.hashSlots());
+    add(kNameOrdinal, c.nameOrdinal);
+    add(kSolvedMask, c.solvedMask);
+    add(kFirstAcceptedTime, c.firstAcceptedTime);
+    add(kWrongBeforeFirstAccepted, c.wrongBeforeFirstAccepted);
+    add(kFrozenMask, c.frozenMask);
+    add(kTeamFreezeEpoch, c.teamFreezeEpoch);
+    add(kFreezeSlot, c.freezeSlot);
+    add(kFreezeActiveTeams, c.freezeActiveTeams);
+    add(kFreezeCells, c.freezeCells);
+    add(kQueryHead, c.queryHead);
+    add(kQueryProblems, c.queryProblems);
+    for (size_t rows = 0; rows < c.queryOwner.size(); ++rows) {
+        size_t blocks = c.queryOwner[rows].size(), blockBytes = rows * Contest::kQueryRowWords * sizeof(uint32_t);
+        for (size_t ch = 0, b = 0; b < blocks; b += Contest::queryChunkBlocks(ch++)) {
+            size_t n = min((size_t)Contest::queryChunkBlocks(ch), blocks - b);
+            pieces[kQueryRows].emplace_back(c.queryChunks[rows][ch].data(), n * blockBytes);
+        }
+    }
+    add(kLastFlushedOrder, c.lastFlushedOrder);
+    add(kCachedKeys, c.cachedKeys);
+    add(kKeyDirty, c.keyDirty);
+    add(kDirtyTeams, c.dirtyTeams);
+
+    SnapshotHeader h{};
+    memcpy(h.magic, kSnapshotMagic, sizeof h.magic);
+    h.journalOffset = journalOffset;
+    h.inputLines = inputLines;
+    h.sectionCount = kSnapshotSections;
+    h.freezeEpoch = c.freezeEpoch;
+    h.started = c.started;
+    h.duration = c.duration;
+    h.problemCount = c.problemCount;
+    h.isFrozen = c.isFrozen;
+    h.teamCount = c.teamCount();
+    h.queryRowsUsed = c.queryRowsUsed;
+
+    auto align = [](uint64_t x){ return (x + kSnapshotAlign - 1) / kSnapshotAlign * kSnapshotAlign; };
+    SnapshotSectionEntry table[kSnapshotSections];
+    uint64_t pos = align(sizeof h + sizeof table);
+    for (int s = 0; s < kSnapshotSections; ++s) {
+        uint64_t bytes = 0;
+        for (const auto &piece : pieces[s]) bytes += piece.second;
+        table[s] = SnapshotSectionEntry{pos, bytes};
+        pos = align(pos + bytes);
+    }
+
+    string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    {
+        static const char zeros[kSnapshotAlign] = {};
+        OutputWriter w(fd);
+        uint64_t written = 0;
+        auto put = [&](const void *p, size_t n){ w.put(string_view((const char *)p, n)); written += n; };
+        put(&h, sizeof h);
+        put(table, sizeof table);
+        for (int s = 0; s < kSnapshotSections; ++s) {
+            put(zeros, table[s].offset - written);
+            for (const auto &piece : pieces[s]) put(piece.first, piece.second);
+        }
+        put(zeros, pos - written);
+    }
+    // OutputWriter drops write errors, so check the result by its size
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (uint64_t)st.st_size == pos;
+    close(fd);
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Sections that index other sections must agree with them before anything
+// walks them: name offsets and hash slots, the freeze slots, the flushed
+// order (sorted by its keys) and the dirty list. Plain values such as times
+// and counts are taken as they are.
+inline bool snapshotTeamsConsistent(const Contest &c) {
+    size_t n = (size_t)c.teamCount();
+    const pmr::vector<uint32_t> &offsets = c.teamNames.arenaOffsets();
+    const pmr::vector<int> &slots = c.teamNames.hashSlots();
+    if (offsets[0] != 0 || !is_sorted(offsets.begin(), offsets.end()) || (n && slots.size() < 2 * n)) return false;
+    vector<char> seen(n);
+    for (int id : slots) {
+        if (id < -1 || id >= (int)n || (id >= 0 && seen[id]++)) return false;
+    }
+    if (count(seen.begin(), seen.end(), 1) != (ptrdiff_t)n) return false;
+    if (!c.started) return true;
+
+    auto isPermutation = [&](const pmr::vector<int> &v){
+        vector<char> hit(n);
+        for (int ti : v) {
+            if (ti < 0 || ti >= (int)n || hit[ti]++) return false;
+        }
+        return true;
+    };
+    if (!isPermutation(c.nameOrdinal) || !isPermutation(c.lastFlushedOrder)) return false;
+    uint32_t problems = (1u << c.problemCount) - 1;
+    // Before the first FREEZE every team is in epoch 0 without a slot
+    if (c.freezeEpoch == 0 && (c.isFrozen || !c.freezeActiveTeams.empty())) return false;
+    for (size_t ti = 0; ti < n; ++ti) {
+        if ((c.solvedMask[ti] | c.frozenMask[ti]) & ~problems) return false;
+        if (c.freezeEpoch && c.teamFreezeEpoch[ti] == c.freezeEpoch
+            && (c.freezeSlot[ti] >= c.freezeActiveTeams.size() || c.freezeActiveTeams[c.freezeSlot[ti]] != (int)ti)) {
+            return false;
+        }
+    }
+    for (int ti : c.freezeActiveTeams) {
+        if (ti < 0 || ti >= (int)n || c.teamFreezeEpoch[ti] != c.freezeEpoch) return false;
+    }
+    size_t dirty = 0;
+    for (char d : c.keyDirty) {
+        if (d != 0 && d != 1) return false;
+        dirty += d;
+    }
+    if (dirty != c.dirtyTeams.size()) return false;
+    vector<char> listed(n);
+    for (int ti : c.dirtyTeams) {
+        if (ti < 0 || ti >= (int)n || !c.keyDirty[ti] || listed[ti]++) return false;
+    }
+    return c.withKeyWords([&](auto w){
+        constexpr int W = decltype(w)::value;
+        for (size_t i = 1; i < n; ++i) {
+            if (!PackedRankKey::less<W>(c.keyOf(c.lastFlushedOrder[i - 1]), c.keyOf(c.lastFlushedOrder[i]))) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+inline bool loadSnapshot(Contest &c, const string &path, uint64_t &journalOffset, uint64_t &inputLines,
+                         string &err) {
+    MappedFile file;
+    if (!file.open(path)) {
+        err = "cannot read snapshot " + path;
+        return false;
+    }
+    SnapshotHeader h;
+    if (file.size < sizeof h + sizeof(SnapshotSectionEntry) * kSnapshotSections) {
+        err = "snapshot is truncated";
+        return false;
+    }
+    memcpy(&h, file.data, sizeof h);
+    if (memcmp(h.magic, kSnapshotMagic, sizeof h.magic) != 0 || h.sectionCount != kSnapshotSections) {
+        err = "not a snapshot of this version";
+        return false;
+    }
+    SnapshotSectionEntry table[kSnapshotSections];
+    memcpy(table, file.data + sizeof h, sizeof table);
+
+    size_t teams = (size_t)max(0, h.teamCount);
+    size_t perTeam = h.started ? teams : 0;
+    if (h.started && (h.problemCount < 1 || h.problemCount > kMaxProblems)) {
+        err = "snapshot has an invalid problem count";
+        return false;
+    }
+    size_t cells = perTeam * (size_t)max(0, h.problemCount);
+    int keyWords = h.started ? rankKeyWords(h.problemCount) : 0;
+    bool ok = true;
+    // expected == SIZE_MAX accepts any element count
+    auto load = [&](int s, auto &v, size_t expected){
+        using T = typename remove_reference_t<decltype(v)>::value_type;
+        const SnapshotSectionEntry &e = table[s];
+        if (!ok || e.offset > file.size || e.bytes > file.size - e.offset || e.bytes % sizeof(T)
+            || (expected != SIZE_MAX && e.bytes / sizeof(T) != expected)) {
+            ok = false;
+            return;
+        }
+        v.resize(e.bytes / sizeof(T));
+        memcpy((void *)v.data(), file.data + e.offset, e.bytes);
+    };
+
+    pmr::vector<char> chars;
+    pmr::vector<uint32_t> offsets;
+    pmr::vector<int> slots;
+    load(kNameChars, chars, SIZE_MAX);
+    load(kNameOffsets, offsets, teams + 1);
+    load(kNameSlots, slots, SIZE_MAX);
+    load(kNameOrdinal, c.nameOrdinal, perTeam);
+    load(kSolvedMask, c.solvedMask, perTeam);
+    load(kFirstAcceptedTime, c.firstAcceptedTime, cells);
+    load(kWrongBeforeFirstAccepted, c.wrongBeforeFirstAccepted, cells);
+    load(kFrozenMask, c.frozenMask, perTeam);
+    load(kTeamFreezeEpoch, c.teamFreezeEpoch, perTeam);
+    load(kFreezeSlot, c.freezeSlot, perTeam);
+    load(kFreezeActiveTeams, c.freezeActiveTeams, SIZE_MAX);
+    load(kFreezeCells, c.freezeCells, c.freezeActiveTeams.size() * (size_t)max(0, h.problemCount));
+    load(kQueryHead, c.queryHead, perTeam);
+    load(kQueryProblems, c.queryProblems, perTeam);
+    load(kLastFlushedOrder, c.lastFlushedOrder, perTeam);
+    load(kCachedKeys, c.cachedKeys, perTeam * keyWords);
+    load(kKeyDirty, c.keyDirty, perTeam);
+    load(kDirtyTeams, c.dirtyTeams, SIZE_MAX);
+    if (!ok || offsets.empty() || offsets.back() != chars.size() || (slots.size() & (slots.size() - 1))) {
+        err = "snapshot sections are inconsistent";
+        return false;
+    }
+
+    c.teamNames.restore(chars, offsets, slots);
+    c.started = h.started;
+    c.duration = h.duration;
+    c.problemCount = h.problemCount;
+    c.keyWords = keyWords;
+    c.isFrozen = h.isFrozen;
+    c.freezeEpoch = h.freezeEpoch;
+    if (!snapshotTeamsConsistent(c)) {
+        err = "snapshot sections are inconsistent";
+        return false;
+    }
+
+    // Every team's block must be a slot of its own in the pool of its size;
+    // the pools' owners are not saved but follow from the heads
+    c.queryChunks.clear();
+    c.queryChunks.resize(Contest::kMaxQueryBlock + 1);
+    c.queryOwner.clear();
+    c.queryOwner.resize(Contest::kMaxQueryBlock + 1);
+    uint32_t problems = h.started ? (1u << c.problemCount) - 1 : 0;
+    uint64_t rowsUsed = 0;
+    bool rowsOk = true;
+    for (size_t ti = 0; rowsOk && ti < perTeam; ++ti) {
+        int rows = c.queryBlockRows((int)ti);
+        rowsOk = !(c.queryProblems[ti] & ~problems) && (rows || c.queryHead[ti] == -1);
+        if (rows) c.queryOwner[rows].push_back(-1);
+        rowsUsed += rows;
+    }
+    for (size_t ti = 0; rowsOk && ti < perTeam; ++ti) {
+        if (int rows = c.queryBlockRows((int)ti)) {
+            pmr::vector<int32_t> &owner = c.queryOwner[rows];
+            int b = c.queryHead[ti];
+            rowsOk = b >= 0 && b < (int)owner.size() && owner[b] < 0;
+            if (rowsOk) owner[b] = (int)ti;
+        }
+    }
+    const SnapshotSectionEntry &qe = table[kQueryRows];
+    if (!rowsOk || rowsUsed != (uint64_t)h.queryRowsUsed || qe.offset > file.size
+        || qe.bytes > file.size - qe.offset || qe.bytes != rowsUsed * Contest::kQueryRowWords * sizeof(uint32_t)) {
+        err = "snapshot query rows are inconsistent";
+        return false;
+    }
+    // Pools go back into chunks of the same sizes
+    c.queryRowsUsed = (int)rowsUsed;
+    const char *src = file.data + qe.offset;
+    for (size_t rows = 0; rows < c.queryOwner.size(); ++rows) {
+        size_t blocks = c.queryOwner[rows].size();
+        for (size_t ch = 0, b = 0; b < blocks; b += Contest::queryChunkBlocks(ch++)) {
+            size_t blockWords = rows * Contest::kQueryRowWords;
+            size_t n = min((size_t)Contest::queryChunkBlocks(ch), blocks - b) * blockWords;
+            c.queryChunks[rows].emplace_back((size_t)Contest::queryChunkBlocks(ch) * blockWords);
+            memcpy(c.queryChunks[rows].back().data(), src, n * sizeof(uint32_t));
+            src += n * sizeof(uint32_t);
+        }
+    }
+    c.rebuildFlushedRank();
+    c.lineCache.reset((int)perTeam); // rendered lines are not saved
+    if (c.boardDiff) c.printedRank.assign(perTeam, 0);
+    c.liveRank.reset();
+    // The history is not saved; a new one answers from the restored board on.
+    // Times never decrease, so the contest clock is the latest time in the
+    // teams' ALL rows.
+    c.rankHistory.reset();
+    if (c.started) {
+        int clock = 0;
+        for (size_t ti = 0; ti < perTeam; ++ti) {
+            if (!c.queryProblems[ti]) continue;
+            clock = max(clock, SubmissionRec::unpack(c.queryBlockOf((int)ti)[kJudgeStatusCount]).time);
+        }
+        c.startRankHistory(clock);
+    }
+    journalOffset = h.journalOffset;
+    inputLines = h.inputLines;
+    return true;
+}
+
+// ---------------- Journal ----------------
+
+class EventJournal {
+public:
+    EventJournal() = default;
+    EventJournal(const EventJournal &) = delete;
+    EventJournal &operator=(const EventJournal &) = delete;
+    ~EventJournal() { close(); }
+
+    // Starts an empty journal at path
+    bool create(const string &path) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        base = 0;
+        out = make_unique<OutputWriter>(fd, kBuffer);
+        out->put(string_view(kJournalMagic, sizeof kJournalMagic));
+        out->flush();
+        syncedEnd = offset();
+        return true;
+    }
+
+    // Continues a replayed journal, cutting off the records after validEnd,
+    // where `lines` input lines had been applied
+    bool append(const string &path, uint64_t validEnd, uint64_t lines) {
+        fd = ::open(path.c_str(), O_WRONLY);
+        if (fd < 0 || ftruncate(fd, (off_t)validEnd) != 0 || lseek(fd, 0, SEEK_END) < 0) return false;
+        base = syncedEnd = validEnd;
+        syncedLines = lines;
+        out = make_unique<OutputWriter>(fd, kBuffer);
+        return true;
+    }
+
+    // Snapshot to path at the first sync after every `every` logged events
+    void setSnapshots(const string &path, uint64_t every) {
+        snapshotPath = path;
+        snapshotEvery = max<uint64_t>(1, every);
+    }
+
+    void logAddTeam(string_view name) {
+        size_t n = min<size_t>(name.size(), 255);
+        tag(JournalTag::AddTeam);
+        out->put((char)n);
+        out->put(name.substr(0, n));
+    }
+
+    void logStart(int duration, int problems) {
+        tag(JournalTag::Start);
+        putBytes((uint64_t)(uint32_t)duration, 4);
+        out->put((char)problems);
+    }
+
+    void logSubmit(int ti, int p, JudgeStatus st, int time) {
+        tag(JournalTag::Submit);
+        putBytes((uint64_t)ti << (5 + 2 + kTimeBits) | (uint64_t)p << (2 + kTimeBits)
+                 | (uint64_t)st << kTimeBits | (uint64_t)time, 7);
+    }
+
+    // FLUSH, FREEZE or SCROLL
+    void logCommand(JournalTag t) { tag(t); }
+
+    // Called once per logged event, after the event has been applied
+    void afterEvent() { ++sinceSnapshot; }
+
+    uint64_t offset() const { return base + out->bytesWritten(); }
+
+    // Events logged since the last sync
+    bool unsynced() const { return out && offset() != syncedEnd; }
+
+    bool snapshotDue() const { return !snapshotPath.empty() && sinceSnapshot >= snapshotEvery; }
+
+    // Input lines applied as of the last sync
+    uint64_t linesApplied() const { return syncedLines; }
+
+    // Input lines [0, lines) have been applied, none after them: records
+    // that, writes the journal out to the file and takes a due snapshot
+    void sync(const Contest &contest, uint64_t lines) {
+        if (lines == syncedLines && !unsynced()) return;
+        tag(JournalTag::Lines);
+        putBytes(lines, 8);
+        out->flush();
+        syncedEnd = offset();
+        syncedLines = lines;
+        if (!snapshotDue()) return;
+        sinceSnapshot = 0;
+        if (!saveSnapshot(contest, snapshotPath, syncedEnd, lines)) {
+            fprintf(stderr, "[Warning]Snapshot to %s failed.\n", snapshotPath.c_str());
+        }
+    }
+
+private:
+    static constexpr size_t kBuffer = 1 << 16;
+
+    void tag(JournalTag t) { out->put((char)t); }
+
+    // Little-endian, n bytes
+    void putBytes(uint64_t v, int n) {
+        char buf[8];
+        for (int i = 0; i < n; ++i) buf[i] = (char)(v >> (8 * i));
+        out->put(string_view(buf, n));
+    }
+
+    void close() {
+        out.reset(); // flushes
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    int fd = -1;
+    uint64_t base = 0; // file offset the writer started at
+    unique_ptr<OutputWriter> out;
+    uint64_t syncedEnd = 0; // offset just past the last LINES record
+    uint64_t syncedLines = 0;
+    string snapshotPath;
+    uint64_t snapshotEvery = 1;
+    uint64_t sinceSnapshot = 0;
+};
+
+// Size of the journal record at data[pos], or 0 if it is partial or has no
+// known tag
+inline size_t journalRecordSize(const char *data, size_t size, size_t pos) {
+    size_t n = 0;
+    switch ((JournalTag)data[pos]) {
+    case JournalTag::AddTeam: n = pos + 1 < size ? 2 + (unsigned char)data[pos + 1] : 2; break;
+    case JournalTag::Start: n = 6; break;
+    case JournalTag::Submit: n = 8; break;
+    case JournalTag::Flush:
+    case JournalTag::Freeze:
+    case JournalTag::Scroll: n = 1; break;
+    case JournalTag::Lines: n = 9; break;
+    }
+    return n <= size - pos ? n : 0;
+}
+
+// Applies the journal records in data[from, size) up to the last LINES
+// record, with replies sent to sink. `end` becomes the offset just past that
+// record and `lines` its count. Fails on a record that does not apply: that
+// is damage, not a write cut short.
+inline bool replayJournal(Contest &c, const char *data, size_t size, uint64_t from, OutputWriter &sink,
+                          uint64_t &end, uint64_t &lines, uint64_t &events) {
+    auto bytes = [&](size_t at, int n){
+        uint64_t v = 0;
+        for (int i = 0; i < n; ++i) v |= (uint64_t)(unsigned char)data[at + i] << (8 * i);
+        return v;
+    };
+    end = from;
+    for (size_t pos = from, n; pos < size && (n = journalRecordSize(data, size, pos)); pos += n) {
+        if ((JournalTag)data[pos] == JournalTag::Lines) end = pos + n;
+    }
+    for (size_t pos = from; pos < end; pos += journalRecordSize(data, size, pos)) {
+        JournalTag t = (JournalTag)data[pos];
+        if (t == JournalTag::AddTeam) {
+            c.addTeam(string_view(data + pos + 2, (unsigned char)data[pos + 1]));
+        } else if (t == JournalTag::Start) {
+            c.startContest((int)bytes(pos + 1, 4), (unsigned char)data[pos + 5]);
+        } else if (t == JournalTag::Submit) {
+            uint64_t v = bytes(pos + 1, 7);
+            int ti = (int)(v >> (5 + 2 + kTimeBits) & ((1u << kJournalTeamBits) - 1));
+            int p = (int)(v >> (2 + kTimeBits) & 31);
+            if (!c.started || ti >= c.teamCount() || p >= c.problemCount) return false;
+            c.recordSubmit(ti, p, (JudgeStatus)(v >> kTimeBits & 3), (int)(v & ((1u << kTimeBits) - 1)));
+        } else if (t == JournalTag::Flush) {
+            c.flushScoreboard();
+        } else if (t == JournalTag::Freeze) {
+            if (!c.isFrozen) c.beginFreeze();
+        } else if (t == JournalTag::Scroll) {
+            if (c.isFrozen) c.doScroll(sink);
+        } else {
+            lines = bytes(pos + 1, 8);
+            continue;
+        }
+        ++events;
+    }
+    return true;
+}
+
+// Loads the snapshot (when snapshotPath names an existing file), replays
+// the journal tail and leaves the journal open for appending; the input
+// resumes after journal.linesApplied() lines
+inline bool restoreContest(Contest &c, const string &snapshotPath, const string &journalPath,
+                           EventJournal &journal, string &err) {
+    auto t0 = chrono::steady_clock::now();
+    uint64_t from = sizeof kJournalMagic, lines = 0;
+    bool fromSnapshot = !snapshotPath.empty() && access(snapshotPath.c_str(), F_OK) == 0;
+    if (fromSnapshot && !loadSnapshot(c, snapshotPath, from, lines, err)) return false;
+
+    MappedFile log;
+    if (!log.open(journalPath)) {
+        err = "cannot read journal " + journalPath;
+        return false;
+    }
+    if (log.size < sizeof kJournalMagic || memcmp(log.data, kJournalMagic, sizeof kJournalMagic) != 0) {
+        err = "not a journal of this version";
+        return false;
+    }
+    if (from > log.size) {
+        err = "snapshot is newer than the journal";
+        return false;
+    }
+
+    int devnull = open("/dev/null", O_WRONLY);
+    uint64_t events = 0, end;
+    bool replayed;
+    {
+        OutputWriter sink(devnull);
+        replayed = replayJournal(c, log.data, log.size, from, sink, end, lines, events);
+    }
+    if (devnull >= 0) close(devnull);
+    if (!replayed) {
+        err = "journal is damaged";
+        return false;
+    }
+    if (!journal.append(journalPath, end, lines)) {
+        err = "cannot append to journal " + journalPath;
+        return false;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    fprintf(stderr, "[Info]Restored %d teams%s through input line %llu (%llu events replayed, %llu bytes dropped)"
+            " in %.1f ms.\n", c.teamCount(), fromSnapshot ? " from snapshot" : "", (unsigned long long)lines,
+            (unsigned long long)events, (unsigned long long)(log.size - end), ms);
+    return true;
+}
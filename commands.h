@@ -0,0 +1,292 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include "checkpoint.h"
+#include "contest.h"
+#include "input_reader.h"
+#include "output_writer.h"
+#include "submit_batch.h"
+using namespace std;
+
+// Command handlers shared by the stdin driver and the benchmark; each writes
+// exactly the replies the judge expects.
+
+inline void runFlush(Contest &contest, OutputWriter &out) {
+    contest.flushScoreboard();
+    out << "[Info]Flush scoreboard.\n";
+}
+
+inline void runFreeze(Contest &contest, OutputWriter &out) {
+    if (contest.isFrozen) {
+        out << "[Error]Freeze failed: scoreboard has been frozen.\n";
+    } else {
+        contest.beginFreeze();
+        out << "[Info]Freeze scoreboard.\n";
+    }
+}
+
+inline void runScroll(Contest &contest, OutputWriter &out) {
+    if (!contest.isFrozen) {
+        out << "[Error]Scroll failed: scoreboard has not been frozen.\n";
+    } else {
+        contest.doScroll(out);
+    }
+}
+
+// Reply to QUERY_RANKING for an existing team
+inline void writeRankingReply(OutputWriter &out, string_view teamName, int rank, bool frozen) {
+    out << "[Info]Complete query ranking.\n";
+    if (frozen) {
+        out << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
+    }
+    out << teamName << " NOW AT RANKING " << rank << "\n";
+}
+
+inline void runQueryRanking(const Contest &contest, OutputWriter &out, string_view teamName) {
+    int ti = contest.findTeam(teamName);
+    if (ti < 0) {
+        out << "[Error]Query ranking failed: cannot find the team.\n";
+        return;
+    }
+    writeRankingReply(out, teamName, contest.flushedRank[ti], contest.isFrozen);
+}
+
+// Rank the team would have if the board were flushed now; frozen problems
+// stay hidden as on the board
+inline void runQueryLiveRanking(Contest &contest, OutputWriter &out, string_view teamName) {
+    int ti = contest.findTeam(teamName);
+    if (ti < 0) {
+        out << "[Error]Query live ranking failed: cannot find the team.\n";
+        return;
+    }
+    if (!contest.started) {
+        out << "[Error]Query live ranking failed: competition has not started.\n";
+        return;
+    }
+    out << "[Info]Complete query live ranking.\n";
+    if (contest.isFrozen) {
+        out << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
+    }
+    out << teamName << " NOW AT LIVE RANKING " << contest.liveRankOf(ti) << "\n";
+}
+
+// PRINT TOP k, PRINT RANGE a b (ranks a..b) or PRINT AROUND team r (r rows
+// either side of the team): a page of the flushed board, clamped to it
+inline void runPrint(Contest &contest, OutputWriter &out, const CommandTokens &tokens) {
+    const string_view *tok = tokens.tok;
+    string_view mode = tokens.count >= 2 ? tok[1] : string_view();
+    bool top = mode == "TOP" && tokens.count == 3;
+    bool range = mode == "RANGE" && tokens.count == 4;
+    bool around = mode == "AROUND" && tokens.count == 4;
+    if (!top && !range && !around) {
+        out << "[Error]Print failed: unknown page.\n";
+        return;
+    }
+    if (!contest.started) {
+        out << "[Error]Print failed: competition has not started.\n";
+        return;
+    }
+    long long first, last;
+    if (top) {
+        first = 1;
+        last = parseInt(tok[2]);
+    } else if (range) {
+        first = parseInt(tok[2]);
+        last = parseInt(tok[3]);
+    } else {
+        int ti = contest.findTeam(tok[2]);
+        if (ti < 0) {
+            out << "[Error]Print failed: cannot find the team.\n";
+            return;
+        }
+        int r = parseInt(tok[3]);
+        first = (long long)contest.flushedRank[ti] - r;
+        last = (long long)contest.flushedRank[ti] + r;
+    }
+    out << "[Info]Print scoreboard.\n";
+    first = max(first, 1LL);
+    last = min(last, (long long)contest.teamCount());
+    if (first <= last) contest.printScoreboardPage(out, (int)first, (int)last);
+}
+
+// QUERY_RANKING team AT t: the team's rank on the last board flushed at or
+// before contest time t (--rank-history)
+inline void runQueryRankingAt(const Contest &contest, OutputWriter &out, string_view teamName, int t) {
+    int ti = contest.findTeam(teamName);
+    if (ti < 0) {
+        out << "[Error]Query ranking failed: cannot find the team.\n";
+        return;
+    }
+    if (!contest.rankHistory) {
+        out << "[Error]Query ranking failed: ranking history is not recorded.\n";
+        return;
+    }
+    int rank;
+    bool frozen;
+    if (!contest.rankHistory->rankAt(ti, t, rank, frozen)) {
+        out << "[Error]Query ranking failed: no ranking recorded at that time.\n";
+        return;
+    }
+    out << "[Info]Complete query ranking.\n";
+    if (frozen) {
+        out << "[Warning]Scoreboard was frozen at that time. The ranking may be inaccurate.\n";
+    }
+    out << teamName << " WAS AT RANKING " << rank << " AT " << t << "\n";
+}
+
+// probVal / statusVal are the parts after "PROBLEM=" and "STATUS="; the
+// results are the p / s arguments of Contest::latestSubmission, except that
+// p is -1 for a letter outside the contest (problemCount means ALL)
+inline void parseSubmissionFilter(const Contest &contest, string_view probVal, string_view statusVal,
+                                  int &p, int &s) {
+    p = contest.problemCount;
+    if (probVal != "ALL") {
+        p = probVal.empty() ? -1 : probVal[0] - 'A';
+        if (p < 0 || p >= contest.problemCount) p = -1;
+    }
+    s = kJudgeStatusCount;
+    JudgeStatus js;
+    if (statusVal != "ALL" && toJudgeStatus(statusVal, js)) s = (int)js;
+}
+
+// Reply to QUERY_SUBMISSION for an existing team
+inline void writeSubmissionReply(const Contest &contest, OutputWriter &out, int ti, int p, int s) {
+    out << "[Info]Complete query submission.\n";
+    SubmissionRec last;
+    if (p < 0 || !contest.latestSubmission(ti, p, s, last)) {
+        out << "Cannot find any submission.\n";
+    } else {
+        out << contest.teamName(ti) << ' ' << last.problem << ' '
+            << judgeStatusName(last.status) << ' ' << last.time << "\n";
+    }
+}
+
+inline void runQuerySubmission(const Contest &contest, OutputWriter &out, string_view teamName,
+                               string_view probVal, string_view statusVal) {
+    int ti = contest.findTeam(teamName);
+    if (ti < 0) {
+        out << "[Error]Query submission failed: cannot find the team.\n";
+        return;
+    }
+    int p, s;
+    parseSubmissionFilter(contest, probVal, statusVal, p, s);
+    writeSubmissionReply(contest, out, ti, p, s);
+}
+
+// A SUBMIT line with its team resolved
+struct SubmitArgs {
+    int team;
+    int problem;
+    JudgeStatus status;
+    int time;
+};
+
+// SUBMIT [problem_name] BY [team_name] WITH [submit_status] AT [time]; false
+// for any other command, a malformed SUBMIT or an unknown team
+inline bool parseSubmit(const CommandTokens &tokens, const Contest &contest, SubmitArgs &s) {
+    const string_view *tok = tokens.tok;
+    if (tokens.count != 8 || tok[0] != "SUBMIT") return false;
+    s.team = contest.findTeam(tok[3]);
+    if (s.team < 0) return false;
+    s.problem = tok[1][0] - 'A';
+    s.status = JudgeStatus::Wrong_Answer;
+    toJudgeStatus(tok[5], s.status); // input guaranteed valid
+    s.time = parseInt(tok[7]);
+    return true;
+}
+
+// SUBMIT with the team already resolved; journals the event (the caller
+// still owes the journal its afterEvent call)
+inline void applySubmit(Contest &contest, int ti, int p, JudgeStatus st, int time) {
+    contest.recordSubmit(ti, p, st, time);
+    if (contest.journal) contest.journal->logSubmit(ti, p, st, time);
+}
+
+// Applies and empties a run of SUBMITs collected by the driver
+inline void applySubmits(Contest &contest, SubmitBatch &batch) {
+    batch.apply(contest.teamCount(), [&](int ti, int p, JudgeStatus st, int time){
+        applySubmit(contest, ti, p, st, time);
+        if (contest.journal) contest.journal->afterEvent();
+    }, [&](int ti, int p){ contest.prefetchSubmit(ti, p); });
+}
+
+// Executes one tokenized command; returns false once END has been handled.
+// State-changing commands are appended to the journal when there is one;
+// syncing it is left to the driver, which knows the input position.
+inline bool executeCommand(Contest &contest, OutputWriter &out, const CommandTokens &tokens) {
+    const string_view *tok = tokens.tok;
+    string_view cmd = tok[0];
+    EventJournal *journal = contest.journal;
+    bool logged = journal != nullptr;
+
+    if (cmd == "ADDTEAM") {
+        string_view name = tok[1];
+        if (!contest.addTeam(name)) {
+            if (contest.started) {
+                out << "[Error]Add failed: competition has started.\n";
+            } else {
+                out << "[Error]Add failed: duplicated team name.\n";
+            }
+        } else {
+            out << "[Info]Add successfully.\n";
+            if (journal) journal->logAddTeam(name);
+        }
+    } else if (cmd == "START") {
+        // START DURATION [duration_time] PROBLEM [problem_count]
+        // tokens: START DURATION x PROBLEM y
+        if (contest.started) {
+            out << "[Error]Start failed: competition has started.\n";
+        } else {
+            int dur = parseInt(tok[2]);
+            int m = parseInt(tok[4]);
+            contest.startContest(dur, m);
+            out << "[Info]Competition starts.\n";
+            if (journal) journal->logStart(dur, m);
+        }
+    } else if (cmd == "SUBMIT") {
+        SubmitArgs s;
+        if (parseSubmit(tokens, contest, s)) applySubmit(contest, s.team, s.problem, s.status, s.time);
+        else logged = false;
+    } else if (cmd == "FLUSH") {
+        runFlush(contest, out);
+        if (journal) journal->logCommand(JournalTag::Flush);
+    } else if (cmd == "FREEZE") {
+        runFreeze(contest, out);
+        if (journal) journal->logCommand(JournalTag::Freeze);
+    } else if (cmd == "SCROLL") {
+        runScroll(contest, out);
+        if (journal) journal->logCommand(JournalTag::Scroll);
+    } else if (cmd == "QUERY_RANKING") {
+        logged = false;
+        // QUERY_RANKING team [AT time]
+        if (tokens.count == 4 && tok[2] == "AT") runQueryRankingAt(contest, out, tok[1], parseInt(tok[3]));
+        else runQueryRanking(contest, out, tok[1]);
+    } else if (cmd == "QUERY_LIVE_RANKING") {
+        logged = false;
+        runQueryLiveRanking(contest, out, tok[1]);
+    } else if (cmd == "QUERY_SUBMISSION") {
+        // tokens: QUERY_SUBMISSION team WHERE PROBLEM=xxx AND STATUS=yyy
+        logged = false;
+        runQuerySubmission(contest, out, tok[1], tok[3].substr(strlen("PROBLEM=")),
+                           tok[5].substr(strlen("STATUS=")));
+    } else if (cmd == "PRINT") {
+        logged = false;
+        runPrint(contest, out, tokens);
+    } else if (cmd == "STATS") {
+        logged = false;
+        // Diagnostics go to stderr so the judged output is unchanged
+        if (contest.stats) {
+            contest.stats->dump(stderr, out.bytesWritten(), contest.queryRowsUsed, contest.queryRowBytes());
+        } else {
+            fputs("[Stats]disabled; run with --stats or SCOREBOARD_STATS=1\n", stderr);
+        }
+    } else if (cmd == "END") {
+        out << "[Info]Competition ends.\n";
+        return false;
+    } else {
+        // Unknown command: per spec, inputs are valid; ignore
+        logged = false;
+    }
+    if (logged) journal->afterEvent();
+    return true;
+}
@@ -0,0 +1,722 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include "contest_types.h"
+#include "line_cache.h"
+#include "live_rank.h"
+#include "name_table.h"
+#include "rank_history.h"
+#include "output_writer.h"
+#include "rank_order.h"
+#include "stats.h"
+#include "worker_pool.h"
+using namespace std;
+
+class EventJournal;
+
+struct Contest {
+    // Every column allocates from here; a hosted contest (contest_host.h)
+    // passes its own arena so that END can drop all of it at once
+    pmr::memory_resource *memory;
+
+    explicit Contest(pmr::memory_resource *memory = pmr::get_default_resource())
+        : memory(memory), teamNames(memory) {}
+
+    Contest(const Contest &) = delete;
+    Contest &operator=(const Contest &) = delete;
+
+    bool started = false;
+    int duration = 0;
+    int problemCount = 0; // M
+
+    bool isFrozen = false; // global freeze flag
+    uint32_t freezeEpoch = 0; // bumped by every FREEZE, invalidating all frozen masks at once
+    // Teams submitting since the current FREEZE; a team's position here is its freeze slot
+    pmr::vector<int> freezeActiveTeams{memory};
+
+    // Team index is the team's id in teamNames
+    NameTable teamNames;
+    pmr::vector<int> nameOrdinal{memory}; // position of the team's name in lexicographic order, set at START
+
+    // Board state, column-oriented so that 10^6 teams stay compact: per-team
+    // words plus dense (team, problem) cells at cellIndex(ti, p)
+    pmr::vector<uint32_t> solvedMask{memory};
+    pmr::vector<int32_t> firstAcceptedTime{memory}; // valid only where solved
+    pmr::vector<int32_t> wrongBeforeFirstAccepted{memory}; // total wrong before the first Accepted over entire timeline
+
+    // Problems unsolved at FREEZE with post-freeze submissions that SCROLL has
+    // not revealed yet; a team's mask only counts while its epoch matches
+    pmr::vector<uint32_t> frozenMask{memory};
+    pmr::vector<uint32_t> teamFreezeEpoch{memory};
+    pmr::vector<uint32_t> freezeSlot{memory}; // index into freezeActiveTeams, valid with the epoch
+
+    // Freeze snapshot of one problem, captured on its first post-freeze
+    // submission; problemCount cells per freeze slot
+    struct FreezeCell {
+        int32_t wrongAtFreeze; // x in -x/y
+        int32_t postFreezeCount; // y in -x/y
+    };
+    pmr::vector<FreezeCell> freezeCells{memory};
+
+    // Latest submission for every QUERY_SUBMISSION filter: (problem or ALL) x
+    // (status or ALL), in rows of kJudgeStatusCount + 1 packed SubmissionRecs
+    // (one per status, then ALL). A team's rows form one block: the ALL row,
+    // then a row per problem it has tried in problem order, so problem p's
+    // row is 1 + popcount(queryProblems[ti] & (bit(p) - 1)) rows in and a
+    // team costs one row plus one per problem tried. Blocks of each size sit
+    // densely in their own pool, at queryHead[ti] in the pool of the team's
+    // size. A problem's first touch moves the team to the next pool and the
+    // last block of the old pool into the hole, so no pool holds gaps. Pools
+    // grow in chunks so growing never copies the blocks already there; the
+    // chunks double from kFirstQueryChunk blocks up to kQueryBlocksPerChunk,
+    // so a contest of a few teams does not commit thousands of rows to its
+    // arena.
+    static constexpr int kQueryRowWords = kJudgeStatusCount + 1;
+    static constexpr int kMaxQueryBlock = kMaxProblems + 1; // rows
+    static constexpr int kFirstQueryChunk = 4;
+    static constexpr int kQueryBlocksPerChunk = 4096;
+    static constexpr int kGrowingQueryChunks = 11; // chunks below kQueryBlocksPerChunk
+    static_assert(kFirstQueryChunk << (kGrowingQueryChunks - 1) == kQueryBlocksPerChunk);
+    pmr::vector<int32_t> queryHead{memory}; // per team, its block in its pool, -1 until the first submission
+    pmr::vector<uint32_t> queryProblems{memory}; // per team, mask of problems that have a row
+    // Per block size in rows: the pool's chunks and the team owning each block
+    pmr::vector<pmr::vector<pmr::vector<uint32_t>>> queryChunks{memory};
+    pmr::vector<pmr::vector<int32_t>> queryOwner{memory};
+    int queryRowsUsed = 0;
+
+    // last flushed ranking (indices into teams)
+    pmr::vector<int> lastFlushedOrder{memory}; // order of team indices
+    pmr::vector<int> flushedRank{memory}; // inverse of lastFlushedOrder: team index -> 1-based rank
+
+    // Cached visible rank key per team, keyWords words each; a team is dirty
+    // when its key may have changed since the last FLUSH (a submission or a
+    // scroll unfreeze touched it)
+    int keyWords = 0; // rankKeyWords(M), set at START
+    pmr::vector<uint64_t> cachedKeys{memory};
+    pmr::vector<char> keyDirty{memory};
+    pmr::vector<int> dirtyTeams{memory};
+
+    // Rendered board line tails; a submission or an unfreeze touches the
+    // team's entry (FREEZE alone changes no visible cell)
+    TeamLineCache lineCache{memory};
+    // Diff output: boards list only rows whose rank or cells changed since
+    // the previous print
+    bool boardDiff = false;
+    pmr::vector<int> printedRank{memory}; // 0 until printed; diff mode only
+
+    // Unflushed ranks under the current freeze visibility, built by the
+    // first QUERY_LIVE_RANKING and kept current from then on
+    unique_ptr<LiveRankIndex> liveRank;
+
+    // Flushed rankings of the past for QUERY_RANKING ... AT t; recorded from
+    // START on when keepRankHistory is set
+    bool keepRankHistory = false;
+    unique_ptr<RankHistory> rankHistory;
+
+    // Optional worker pool for large FLUSHes and board rendering; output is
+    // identical with or without it
+    WorkerPool *pool = nullptr;
+
+    // Optional counters; null unless statistics were requested
+    RuntimeStats *stats = nullptr;
+
+    // Optional crash-recovery journal, written by executeCommand
+    EventJournal *journal = nullptr;
+
+    int teamCount() const { return teamNames.size(); }
+
+    size_t cellIndex(int ti, int p) const { return (size_t)ti * problemCount + p; }
+
+    const uint64_t *keyOf(int ti) const { return cachedKeys.data() + (size_t)ti * keyWords; }
+    uint64_t *keyOf(int ti) { return cachedKeys.data() + (size_t)ti * keyWords; }
+
+    // Runs f(integral_constant<int, W>) for this contest's key width, once
+    // per operation, so the hot loops inside are specialized on it
+    template <class F>
+    decltype(auto) withKeyWords(F f) const { return withRankKeyWords(keyWords, f); }
+
+    // Helper to (re)initialize the board columns when START happens
+    void initializeTeamsProblems(int m) {
+        size_t n = (size_t)teamCount();
+        solvedMask.assign(n, 0);
+        firstAcceptedTime.assign(n * m, 0);
+        wrongBeforeFirstAccepted.assign(n * m, 0);
+        frozenMask.assign(n, 0);
+        teamFreezeEpoch.assign(n, 0);
+        freezeSlot.assign(n, 0);
+        queryHead.assign(n, -1);
+        queryProblems.assign(n, 0);
+        queryChunks.resize(kMaxQueryBlock + 1);
+        queryOwner.resize(kMaxQueryBlock + 1);
+        keyDirty.assign(n, 0);
+        dirtyTeams.clear();
+        // initial lastFlushedOrder: lexicographic by team name; the only string
+        // comparisons, every later tie-break uses nameOrdinal
+        lastFlushedOrder.resize(n);
+        iota(lastFlushedOrder.begin(), lastFlushedOrder.end(), 0);
+        sort(lastFlushedOrder.begin(), lastFlushedOrder.end(), [&](int a, int b){
+            return teamNames.name(a) < teamNames.name(b);
+        });
+        nameOrdinal.resize(n);
+        for (size_t i = 0; i < n; ++i) nameOrdinal[lastFlushedOrder[i]] = (int)i;
+        // no solves yet: every key is empty and the name order above is exact
+        lineCache.reset((int)n);
+        if (boardDiff) printedRank.assign(n, 0);
+        liveRank.reset();
+        keyWords = rankKeyWords(m);
+        cachedKeys.resize(n * keyWords);
+        withKeyWords([&](auto w){
+            constexpr int W = decltype(w)::value;
+            const int none[PackedRankKey::timeFields(W)] = {};
+            for (size_t i = 0; i < n; ++i) PackedRankKey::make<W>(keyOf(i), 0, 0, none, nameOrdinal[i]);
+        });
+        rebuildFlushedRank();
+        startRankHistory(0);
+    }
+
+    // With keepRankHistory, a new history whose first version is the board
+    // as last flushed, stamped with contest time `since`
+    void startRankHistory(int since) {
+        rankHistory.reset();
+        if (keepRankHistory) {
+            withKeyWords([&](auto w){
+                rankHistory = make_unique<RankHistoryTree<decltype(w)::value>>(lastFlushedOrder, cachedKeys.data(),
+                                                                               since, isFrozen);
+            });
+        }
+    }
+
+    // Must follow every change to lastFlushedOrder
+    void rebuildFlushedRank() {
+        flushedRank.resize(lastFlushedOrder.size());
+        for (size_t i = 0; i < lastFlushedOrder.size(); ++i) {
+            flushedRank[lastFlushedOrder[i]] = (int)i + 1;
+        }
+    }
+
+    // Blocks in chunk c of a pool: kFirstQueryChunk in the first two, then
+    // twice as many as the one before until kQueryBlocksPerChunk, so the
+    // blocks before chunk c (1 <= c <= kGrowingQueryChunks) are
+    // kFirstQueryChunk << (c - 1)
+    static int queryChunkBlocks(size_t c) {
+        if (c == 0) return kFirstQueryChunk;
+        return c <= kGrowingQueryChunks ? kFirstQueryChunk << (c - 1) : kQueryBlocksPerChunk;
+    }
+
+    // Chunk of block b, and b's index within it
+    static pair<size_t, int> queryChunkOf(int b) {
+        if (b < kFirstQueryChunk) return {0, b};
+        if (b < kQueryBlocksPerChunk) {
+            size_t c = 32 - __builtin_clz((unsigned)(b / kFirstQueryChunk));
+            return {c, b - (kFirstQueryChunk << (c - 1))};
+        }
+        return {(size_t)(b / kQueryBlocksPerChunk + kGrowingQueryChunks - 1), b % kQueryBlocksPerChunk};
+    }
+
+    // Rows in team ti's block (0 before its first submission)
+    int queryBlockRows(int ti) const {
+        return queryProblems[ti] ? __builtin_popcount(queryProblems[ti]) + 1 : 0;
+    }
+
+    // Offset of problem p's row in a block holding the problems in mask
+    static int queryRowIndex(uint32_t mask, int p) {
+        return 1 + __builtin_popcount(mask & ((1u << p) - 1));
+    }
+
+    const uint32_t *queryBlock(int rows, int b) const {
+        auto [c, i] = queryChunkOf(b);
+        return queryChunks[rows][c].data() + (size_t)i * rows * kQueryRowWords;
+    }
+
+    uint32_t *queryBlock(int rows, int b) {
+        return const_cast<uint32_t *>(as_const(*this).queryBlock(rows, b));
+    }
+
+    // Team ti's block; it must have submitted
+    const uint32_t *queryBlockOf(int ti) const { return queryBlock(queryBlockRows(ti), queryHead[ti]); }
+    uint32_t *queryBlockOf(int ti) { return queryBlock(queryBlockRows(ti), queryHead[ti]); }
+
+    // Moves team ti to the next pool, into a block with a zeroed row for
+    // problem p
+    uint32_t *addQueryProblem(int ti, int p) {
+        int rows = queryBlockRows(ti), grown = rows ? rows + 1 : 2;
+        pmr::vector<int32_t> &owner = queryOwner[grown];
+        int b = (int)owner.size();
+        auto [c, i] = queryChunkOf(b);
+        if (c == queryChunks[grown].size()) {
+            queryChunks[grown].emplace_back((size_t)queryChunkBlocks(c) * grown * kQueryRowWords);
+        }
+        owner.push_back(ti);
+        uint32_t *dst = queryBlock(grown, b);
+        size_t before = (size_t)queryRowIndex(queryProblems[ti], p) * kQueryRowWords;
+        if (rows) {
+            memcpy(dst, queryBlockOf(ti), before * sizeof(uint32_t));
+            memcpy(dst + before + kQueryRowWords, queryBlockOf(ti) + before,
+                   ((size_t)rows * kQueryRowWords - before) * sizeof(uint32_t));
+            removeQueryBlock(rows, queryHead[ti]);
+        } else {
+            memset(dst, 0, before * sizeof(uint32_t));
+        }
+        memset(dst + before, 0, kQueryRowWords * sizeof(uint32_t));
+        queryHead[ti] = b;
+        queryProblems[ti] |= 1u << p;
+        queryRowsUsed += grown - rows;
+        return dst;
+    }
+
+    // Fills block b's hole with the pool's last block; a pool keeps at most
+    // one empty chunk past its blocks
+    void removeQueryBlock(int rows, int b) {
+        pmr::vector<int32_t> &owner = queryOwner[rows];
+        int last = (int)owner.size() - 1;
+        if (b != last) {
+            memcpy(queryBlock(rows, b), queryBlock(rows, last), (size_t)rows * kQueryRowWords * sizeof(uint32_t));
+            owner[b] = owner[last];
+            queryHead[owner[b]] = b;
+        }
+        owner.pop_back();
+        pmr::vector<pmr::vector<uint32_t>> &chunks = queryChunks[rows];
+        if (queryChunkOf(last).first + 2 < chunks.size()) chunks.pop_back();
+    }
+
+    // Bytes held by query chunks; grows with the (team, problem) pairs that
+    // have been submitted to, never with the number of submissions
+    size_t queryRowBytes() const {
+        size_t bytes = 0;
+        for (const auto &pool : queryChunks) {
+            for (const auto &chunk : pool) bytes += chunk.size() * sizeof(uint32_t);
+        }
+        return bytes;
+    }
+
+    // Latest submission of team ti matching the filter; p == problemCount and
+    // s == kJudgeStatusCount stand for ALL
+    bool latestSubmission(int ti, int p, int s, SubmissionRec &rec) const {
+        uint32_t mask = queryProblems[ti];
+        if (!mask || (p < problemCount && !(mask >> p & 1))) return false;
+        int row = p < problemCount ? queryRowIndex(mask, p) : 0;
+        uint32_t bits = queryBlockOf(ti)[(size_t)row * kQueryRowWords + s];
+        if (!bits) return false;
+        rec = SubmissionRec::unpack(bits);
+        return true;
+    }
+
+    // Index of the named team, or -1 if there is no such team
+    int findTeam(string_view name) const { return teamNames.find(name); }
+
+    string_view teamName(int ti) const { return teamNames.name(ti); }
+
+    bool addTeam(string_view name) {
+        if (started) return false;
+        return teamNames.insert(name) >= 0; // board columns are sized on START
+    }
+
+    bool startContest(int dur, int m) {
+        if (started) return false;
+        started = true;
+        duration = dur;
+        problemCount = m;
+        initializeTeamsProblems(m);
+        return true;
+    }
+
+    // FREEZE costs O(1): per-problem snapshots are taken lazily in recordSubmit
+    void beginFreeze() {
+        isFrozen = true;
+        ++freezeEpoch;
+        freezeActiveTeams.clear();
+        freezeCells.clear();
+        if (rankHistory) rankHistory->record(nullptr, 0, cachedKeys.data(), true);
+    }
+
+    uint32_t frozenMaskOf(int ti) const {
+        return isFrozen && teamFreezeEpoch[ti] == freezeEpoch ? frozenMask[ti] : 0;
+    }
+
+    const FreezeCell &freezeCell(int ti, int p) const {
+        return freezeCells[(size_t)freezeSlot[ti] * problemCount + p];
+    }
+
+    void recordSubmit(char problemChar, string_view teamName, JudgeStatus st, int time) {
+        recordSubmit(findTeam(teamName), problemChar - 'A', st, time);
+    }
+
+    void recordSubmit(int ti, int p, JudgeStatus st, int time) {
+        char problemChar = char('A' + p);
+        size_t c = cellIndex(ti, p);
+        uint32_t bit = 1u << p;
+        if (rankHistory) rankHistory->advanceClock(time);
+
+        // Remember it under every filter it matches (for QUERY_SUBMISSION)
+        uint32_t *block = queryProblems[ti] & bit ? queryBlockOf(ti) : addQueryProblem(ti, p);
+        const uint32_t rec = SubmissionRec{problemChar, st, time}.pack();
+        uint32_t *latest = block + (size_t)queryRowIndex(queryProblems[ti], p) * kQueryRowWords;
+        latest[(int)st] = rec;
+        latest[kJudgeStatusCount] = rec;
+        block[(int)st] = rec;
+        block[kJudgeStatusCount] = rec;
+        markDirty(ti);
+        lineCache.touch(ti);
+
+        // Freeze accounting: count post-freeze submissions on problems unsolved
+        // at FREEZE. The first one snapshots the problem; a problem that is
+        // solved but not yet frozen was solved before FREEZE and stays visible.
+        if (isFrozen) {
+            if (teamFreezeEpoch[ti] != freezeEpoch) {
+                teamFreezeEpoch[ti] = freezeEpoch;
+                frozenMask[ti] = 0;
+                freezeSlot[ti] = (uint32_t)freezeActiveTeams.size();
+                freezeActiveTeams.push_back(ti);
+                freezeCells.resize(freezeCells.size() + problemCount);
+            }
+            FreezeCell &fc = freezeCells[(size_t)freezeSlot[ti] * problemCount + p];
+            if (frozenMask[ti] & bit) {
+                fc.postFreezeCount++;
+            } else if (!(solvedMask[ti] & bit)) {
+                frozenMask[ti] |= bit;
+                fc.wrongAtFreeze = wrongBeforeFirstAccepted[c];
+                fc.postFreezeCount = 1;
+            }
+        }
+
+        // Update core problem status; submissions after the first AC change nothing
+        if (!(solvedMask[ti] & bit)) {
+            if (st == JudgeStatus::Accepted) {
+                solvedMask[ti] |= bit;
+                firstAcceptedTime[c] = time;
+                // the only change to a visible key outside SCROLL
+                if (liveRank && !(frozenMaskOf(ti) & bit)) refreshLiveRank(ti);
+            } else {
+                // wrong attempts before first accept
+                wrongBeforeFirstAccepted[c]++;
+            }
+        }
+    }
+
+    // Pulls in the state recordSubmit(ti, p, ...) touches; its query rows
+    // come in only if queryHead[ti] is already cached
+    void prefetchSubmit(int ti, int p) const {
+        size_t c = cellIndex(ti, p);
+        __builtin_prefetch(&solvedMask[ti], 1);
+        __builtin_prefetch(&wrongBeforeFirstAccepted[c], 1);
+        __builtin_prefetch(&firstAcceptedTime[c], 1);
+        __builtin_prefetch(&keyDirty[ti], 1);
+        __builtin_prefetch(&queryHead[ti]);
+        __builtin_prefetch(&queryProblems[ti]);
+        lineCache.prefetch(ti);
+        if (uint32_t mask = queryProblems[ti]) {
+            const uint32_t *block = queryBlockOf(ti);
+            __builtin_prefetch(block, 1);
+            if (mask >> p & 1) __builtin_prefetch(block + (size_t)queryRowIndex(mask, p) * kQueryRowWords, 1);
+        }
+    }
+
+    int liveRankOf(int ti) {
+        if (!liveRank) {
+            withKeyWords([&](auto w){
+                constexpr int W = decltype(w)::value;
+                liveRank = make_unique<LiveRankTree<W>>(teamCount(), [&](int t, uint64_t *key){
+                    buildRankKeyForTeamVisible<W>(t, key);
+                });
+            });
+        }
+        return liveRank->rank(ti);
+    }
+
+    void refreshLiveRank(int ti) {
+        withKeyWords([&](auto w){
+            uint64_t key[decltype(w)::value];
+            buildRankKeyForTeamVisible<decltype(w)::value>(ti, key);
+            liveRank->update(ti, key);
+        });
+    }
+
+    void markDirty(int ti) {
+        if (!keyDirty[ti]) {
+            keyDirty[ti] = 1;
+            dirtyTeams.push_back(ti);
+        }
+    }
+
+    template <int W>
+    void buildRankKeyForTeamVisible(int ti, uint64_t *key) const {
+        // frozen problems are invisible while frozen
+        uint32_t visible = solvedMask[ti] & ~frozenMaskOf(ti);
+        const int32_t *acTime = &firstAcceptedTime[cellIndex(ti, 0)];
+        const int32_t *wrong = &wrongBeforeFirstAccepted[cellIndex(ti, 0)];
+        constexpr int N = PackedRankKey::timeFields(W);
+        int buf[N] = {};
+        int cnt = 0;
+        long long penalty = 0;
+        for (uint32_t m = visible; m; m &= m - 1) {
+            int p = __builtin_ctz(m);
+            penalty += 20LL * wrong[p] + acTime[p];
+            buf[cnt++] = acTime[p];
+        }
+        // unsolved fields stay 0 and sort behind every solve time
+        sortTimesDescending<N>(buf, cnt);
+        PackedRankKey::make<W>(key, cnt, penalty, buf, nameOrdinal[ti]);
+    }
+
+    RankEntry rankEntry(int ti) const { return RankEntry{keyOf(ti)[0], ti}; }
+
+    template <int W>
+    bool teamLess(int a, int b) const {
+        // return true if team a ranks higher than team b (uses cached keys)
+        if (stats) stats->comparatorCalls.fetch_add(1, memory_order_relaxed);
+        return PackedRankKey::less<W>(keyOf(a), keyOf(b));
+    }
+
+    // Rebuild the keys of dirty teams, pull them out of lastFlushedOrder and
+    // merge them back in sorted order. Clean teams keep their relative order
+    // because their keys have not changed since the previous flush.
+    void flushScoreboard() {
+        if (dirtyTeams.empty()) return;
+        if (stats) stats->keyRebuilds += dirtyTeams.size();
+        withKeyWords([&](auto w){ flushDirtyTeams<decltype(w)::value>(); });
+    }
+
+    template <int W>
+    void flushDirtyTeams() {
+        auto less = [&](int a, int b){ return teamLess<W>(a, b); };
+        if (pool) {
+            pool->parallelFor(dirtyTeams.size(), 1024, [&](size_t b, size_t e){
+                for (size_t i = b; i < e; ++i) buildRankKeyForTeamVisible<W>(dirtyTeams[i], keyOf(dirtyTeams[i]));
+            });
+            pool->sort(dirtyTeams, less);
+        } else {
+            for (int ti : dirtyTeams) {
+                buildRankKeyForTeamVisible<W>(ti, keyOf(ti));
+            }
+            sort(dirtyTeams.begin(), dirtyTeams.end(), less);
+        }
+
+        vector<int> rest;
+        rest.reserve(lastFlushedOrder.size() - dirtyTeams.size());
+        for (int ti : lastFlushedOrder) {
+            if (!keyDirty[ti]) rest.push_back(ti);
+        }
+        lastFlushedOrder.clear();
+        merge(rest.begin(), rest.end(), dirtyTeams.begin(), dirtyTeams.end(),
+              back_inserter(lastFlushedOrder), less);
+        rebuildFlushedRank();
+        if (rankHistory) rankHistory->record(dirtyTeams.data(), dirtyTeams.size(), cachedKeys.data(), isFrozen);
+
+        for (int ti : dirtyTeams) keyDirty[ti] = 0;
+        dirtyTeams.clear();
+    }
+
+    // Scoreboard cell: "+x" / "+" solved, "-x" / "." unsolved, "-x/y" / "0/y" frozen
+    void writeProblemCell(OutputWriter &out, int ti, int p, bool frozenThis) const {
+        if (frozenThis) {
+            const FreezeCell &fc = freezeCell(ti, p);
+            if (fc.wrongAtFreeze == 0) out.put('0');
+            else { out.put('-'); out.putInt(fc.wrongAtFreeze); }
+            out.put('/');
+            out.putInt(fc.postFreezeCount);
+            return;
+        }
+        int x = wrongBeforeFirstAccepted[cellIndex(ti, p)];
+        if (solvedMask[ti] >> p & 1) {
+            out.put('+');
+            if (x != 0) out.putInt(x);
+        } else if (x == 0) {
+            out.put('.');
+        } else {
+            out.put('-');
+            out.putInt(x);
+        }
+    }
+
+    // "solved penalty cells...\n": the part of a board line kept in lineCache.
+    // Cells, count and penalty are the team's current visible state, which
+    // only differs from its cached key between a submission and the next FLUSH.
+    void writeLineTail(OutputWriter &out, int ti) const {
+        uint32_t frozen = frozenMaskOf(ti);
+        uint32_t visible = solvedMask[ti] & ~frozen;
+        long long penalty = 0;
+        for (uint32_t m = visible; m; m &= m - 1) {
+            size_t c = cellIndex(ti, __builtin_ctz(m));
+            penalty += 20LL * wrongBeforeFirstAccepted[c] + firstAcceptedTime[c];
+        }
+        out << __builtin_popcount(visible) << ' ' << penalty;
+        for (int p = 0; p < problemCount; ++p) {
+            out.put(' ');
+            writeProblemCell(out, ti, p, frozen >> p & 1);
+        }
+        out.put('\n');
+    }
+
+    // Re-render the tails of teams touched since the last print; with a pool
+    // and many of them, slices are rendered in parallel and stored in order
+    void refreshLineTails() {
+        static constexpr size_t kTeamsPerSlice = 2048;
+        const pmr::vector<int> &stale = lineCache.staleTeams();
+        size_t n = stale.size();
+        if (!pool || pool->size() == 1 || n <= kTeamsPerSlice) {
+            OutputWriter scratch(OutputWriter::kMemory, 256);
+            for (int ti : stale) {
+                scratch.clear();
+                writeLineTail(scratch, ti);
+                lineCache.store(ti, scratch.view());
+            }
+            lineCache.clearStale();
+            return;
+        }
+        size_t slices = (n + kTeamsPerSlice - 1) / kTeamsPerSlice;
+        deque<OutputWriter> parts;
+        for (size_t i = 0; i < slices; ++i) parts.emplace_back(OutputWriter::kMemory, kTeamsPerSlice * 32);
+        pool->parallelFor(slices, 1, [&](size_t b, size_t e){
+            for (size_t s = b; s < e; ++s) {
+                for (size_t i = s * kTeamsPerSlice; i < min(n, (s + 1) * kTeamsPerSlice); ++i) {
+                    writeLineTail(parts[s], stale[i]);
+                }
+            }
+        });
+        // Every tail ends in '\n', so each part splits back into its teams
+        size_t i = 0;
+        for (; !parts.empty(); parts.pop_front()) {
+            for (string_view v = parts.front().view(); !v.empty();) {
+                size_t len = v.find('\n') + 1;
+                lineCache.store(stale[i++], v.substr(0, len));
+                v.remove_prefix(len);
+            }
+        }
+        lineCache.clearStale();
+    }
+
+    // Lines for order[begin, end) from the cached tails; ranks are positions
+    // in the full order. In diff mode, rows whose rank and cells are as last
+    // printed are skipped.
+    void writeScoreboardLines(OutputWriter &out, const pmr::vector<int> &order, size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; ++i) {
+            int ti = order[i];
+            int rank = (int)i + 1;
+            if (boardDiff && printedRank[ti] == rank && !lineCache.changedSincePrint(ti)) continue;
+            // team_name ranking solved_count total_penalty A B C ...
+            out << teamName(ti) << ' ' << rank << ' ' << lineCache.tail(ti);
+        }
+    }
+
+    // Rows for ranks [first, last] (1-based) of the flushed ranking, taken
+    // from the line cache where it is fresh; costs O(rows), not O(teams), and
+    // leaves the cache and the diff state alone
+    void printScoreboardPage(OutputWriter &out, int first, int last) const {
+        for (int rank = first; rank <= last; ++rank) {
+            int ti = lastFlushedOrder[rank - 1];
+            out << teamName(ti) << ' ' << rank << ' ';
+            if (lineCache.isStale(ti)) writeLineTail(out, ti);
+            else out << lineCache.tail(ti);
+        }
+    }
+
+    // With a pool, slices of the board are formatted into separate buffers in
+    // parallel and then appended in order
+    void printScoreboard(OutputWriter &out, const pmr::vector<int> &order) {
+        static constexpr size_t kLinesPerSlice = 2048;
+        refreshLineTails();
+        size_t n = order.size();
+        if (!pool || pool->size() == 1 || n <= kLinesPerSlice) {
+            writeScoreboardLines(out, order, 0, n);
+        } else {
+            size_t slices = (n + kLinesPerSlice - 1) / kLinesPerSlice;
+            deque<OutputWriter> parts;
+            for (size_t i = 0; i < slices; ++i) parts.emplace_back(OutputWriter::kMemory, kLinesPerSlice * 32);
+            pool->parallelFor(slices, 1, [&](size_t b, size_t e){
+                for (size_t i = b; i < e; ++i) {
+                    writeScoreboardLines(parts[i], order, i * kLinesPerSlice, min(n, (i + 1) * kLinesPerSlice));
+                }
+            });
+            for (const OutputWriter &part : parts) out.put(part.view());
+        }
+        if (boardDiff) {
+            for (size_t i = 0; i < n; ++i) {
+                printedRank[order[i]] = (int)i + 1;
+                lineCache.markPrinted(order[i]);
+            }
+        }
+    }
+
+    // Perform SCROLL process
+    void doScroll(OutputWriter &out) {
+        // Precondition: isFrozen == true checked by caller
+        out << "[Info]Scroll scoreboard.\n";
+
+        // Scrolling starts from a flushed board, so every cached key is current
+        flushScoreboard();
+
+        // Print scoreboard before scrolling
+        printScoreboard(out, lastFlushedOrder);
+
+        withKeyWords([&](auto w){ scrollFrozenTeams<decltype(w)::value>(out); });
+
+        // After scrolling ends, print the final scoreboard
+        printScoreboard(out, lastFlushedOrder);
+
+        // Lift frozen state; every frozen problem has been unfrozen, so the
+        // cached keys already match the unfrozen visibility and all masks are empty
+        isFrozen = false;
+    }
+
+    // Reveals frozen problems one at a time, printing every rank change,
+    // and leaves the final order in lastFlushedOrder
+    template <int W>
+    void scrollFrozenTeams(OutputWriter &out) {
+        // Full order and its frozen subset, both keyed by packed rank keys;
+        // only teams active since FREEZE can have frozen problems
+        BlockedRankList<W> orderList(cachedKeys.data()), frozenList(cachedKeys.data());
+        for (int ti : lastFlushedOrder) orderList.pushBack(rankEntry(ti));
+        vector<int> frozenTeams;
+        for (int ti : freezeActiveTeams) {
+            if (frozenMaskOf(ti)) frozenTeams.push_back(ti);
+        }
+        sort(frozenTeams.begin(), frozenTeams.end(), [&](int a, int b){ return teamLess<W>(a, b); });
+        for (int ti : frozenTeams) frozenList.pushBack(rankEntry(ti));
+
+        // Loop until no team has frozen problems
+        while (!frozenList.empty()) {
+            RankEntry old = frozenList.back(); // lowest-ranked among frozen teams
+            int ti = old.team;
+            frozenList.erase(old);
+
+            // Team just above ti before the unfreeze
+            const RankEntry *above = orderList.before(old);
+            int aboveTeam = above ? above->team : -1;
+
+            // Unfreeze smallest frozen problem for this team
+            uint32_t &mask = frozenMask[ti];
+            mask &= mask - 1;
+            lineCache.touch(ti);
+            uint64_t newKey[W];
+            buildRankKeyForTeamVisible<W>(ti, newKey);
+            if (stats) {
+                ++stats->scrollUnfreezes;
+                ++stats->keyRebuilds;
+            }
+
+            // Keys only improve, so the team moved up iff it passed its old neighbour
+            if (!PackedRankKey::equal<W>(newKey, keyOf(ti))) {
+                orderList.erase(old);
+                memcpy(keyOf(ti), newKey, sizeof newKey);
+                if (liveRank) liveRank->update(ti, newKey);
+                orderList.insert(rankEntry(ti));
+                if (aboveTeam >= 0 && PackedRankKey::less<W>(newKey, keyOf(aboveTeam))) {
+                    int replacedId = orderList.after(rankEntry(ti))->team;
+                    out << teamName(ti) << ' ' << teamName(replacedId) << ' ' << PackedRankKey::solved(newKey)
+                        << ' ' << PackedRankKey::penalty(newKey) << "\n";
+                }
+            }
+
+            // If still has frozen problems, reinsert into the frozen list
+            if (mask) frozenList.insert(rankEntry(ti));
+        }
+
+        // After scroll, the latest state is effectively flushed; update lastFlushedOrder
+        lastFlushedOrder.clear();
+        orderList.forEach([&](const RankEntry &e){ lastFlushedOrder.push_back(e.team); });
+        rebuildFlushedRank();
+        if (stats) stats->comparatorCalls += orderList.comparisons() + frozenList.comparisons();
+        // the board ends fully revealed, though isFrozen is only lifted after it is printed
+        if (rankHistory) rankHistory->record(frozenTeams.data(), frozenTeams.size(), cachedKeys.data(), false);
+    }
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include "commands.h"
+#include "contest.h"
+#include "input_reader.h"
+#include "mpsc_queue.h"
+#include "output_writer.h"
+using namespace std;
+
+// Multi-contest server mode (--multi N): one process hosts any number of
+// contests multiplexed over stdin. Every input line is "<contest-id>
+// <command>" and every reply line is written back as "<contest-id> <reply>".
+// A contest's replies keep their order; different contests interleave in
+// whole commands.
+//
+// Contests are sharded by a hash of their id over N worker threads, and a
+// worker owns its contests outright: the reader hands each worker batches of
+// lines through its own lock-free queue, and only finished output blocks go
+// through the shared writer's mutex. A contest is created by its first
+// command and allocates everything from its own monotonic arena, released in
+// one step when END destroys it; the id may then start a new contest.
+
+struct HostBatch : MpscNode {
+    string text; // lines, each terminated by '\n'
+    bool last = false; // no more input after this batch
+};
+
+class ContestHost {
+public:
+    ContestHost(OutputWriter &out, int workers) : out(out), shards(max(1, workers)) {}
+
+    ContestHost(const ContestHost &) = delete;
+    ContestHost &operator=(const ContestHost &) = delete;
+
+    // Serves the whole input; returns once every worker has drained
+    void run(InputReader &input) {
+        for (Shard &s : shards) s.worker = thread([this, &s]{ serve(s); });
+        readLoop(input);
+        for (Shard &s : shards) s.worker.join();
+    }
+
+private:
+    static constexpr size_t kBatchBytes = 1 << 15;
+    static constexpr int kMaxInFlight = 16; // batches queued per worker
+
+    struct HostedContest {
+        pmr::monotonic_buffer_resource arena;
+        Contest contest{&arena}; // destroyed before its arena
+    };
+
+    struct Shard {
+        MpscQueue inbox;
+        MpscSignal inboxSignal;
+        atomic<int> inFlight{0};
+        thread worker;
+        // Only touched by the worker thread
+        map<string, unique_ptr<HostedContest>, less<>> contests;
+    };
+
+    // ---- reader ----
+
+    void readLoop(InputReader &input) {
+        size_t n = shards.size();
+        vector<HostBatch *> pending(n, nullptr);
+        auto ship = [&](size_t w){
+            Shard &s = shards[w];
+            // Backpressure: a worker that falls behind holds the reader up
+            for (int spins = 0; s.inFlight.load(memory_order_acquire) >= kMaxInFlight; ++spins) {
+                if (spins < 64) this_thread::yield();
+                else this_thread::sleep_for(chrono::microseconds(50));
+            }
+            s.inFlight.fetch_add(1, memory_order_relaxed);
+            s.inbox.push(pending[w]);
+            s.inboxSignal.notify();
+            pending[w] = nullptr;
+        };
+        string_view line, rest;
+        while (input.nextLine(line)) {
+            string_view id = firstToken(line, rest);
+            if (!id.empty()) {
+                size_t w = hash<string_view>()(id) % n;
+                if (!pending[w]) pending[w] = new HostBatch;
+                pending[w]->text.append(line.data(), line.size());
+                pending[w]->text.push_back('\n');
+                if (pending[w]->text.size() >= kBatchBytes) ship(w);
+            }
+            // About to block on stdin: let the workers answer what has arrived
+            if (input.needsRefill()) {
+                for (size_t w = 0; w < n; ++w) {
+                    if (pending[w]) ship(w);
+                }
+            }
+        }
+        for (size_t w = 0; w < n; ++w) {
+            if (!pending[w]) pending[w] = new HostBatch;
+            pending[w]->last = true;
+            ship(w);
+        }
+    }
+
+    // ---- workers ----
+
+    void serve(Shard &s) {
+        OutputWriter replies(OutputWriter::kMemory, 1 << 12), block(OutputWriter::kMemory, 1 << 16);
+        CommandTokens tokens;
+        for (bool last = false; !last;) {
+            HostBatch *batch = static_cast<HostBatch *>(s.inboxSignal.popOrWait(s.inbox, []{ return false; }));
+            s.inFlight.fetch_sub(1, memory_order_release);
+            last = batch->last;
+
+            // Consecutive lines mostly belong to the same contest
+            string_view cachedId;
+            HostedContest *cached = nullptr;
+            const char *text = batch->text.data();
+            for (size_t pos = 0; pos < batch->text.size();) {
+                size_t nl = (size_t)((const char *)memchr(text + pos, '\n', batch->text.size() - pos) - text);
+                string_view rest, id = firstToken(string_view(text + pos, nl - pos), rest);
+                pos = nl + 1;
+                tokenize(rest, tokens);
+                if (tokens.count == 0) continue;
+
+                if (!cached || id != cachedId) {
+                    auto it = s.contests.find(id);
+                    if (it == s.contests.end()) {
+                        it = s.contests.emplace(string(id), make_unique<HostedContest>()).first;
+                    }
+                    cached = it->second.get();
+                    cachedId = id;
+                }
+                bool more = executeCommand(cached->contest, replies, tokens);
+                prefixLines(block, id, replies.view());
+                replies.clear();
+                if (!more) {
+                    s.contests.erase(s.contests.find(id)); // frees the whole arena
+                    cached = nullptr;
+                }
+            }
+            delete batch;
+
+            if (!block.view().empty()) {
+                lock_guard<mutex> lk(outMu);
+                out.put(block.view());
+                out.flush();
+            }
+            block.clear();
+        }
+        s.contests.clear();
+    }
+
+    static void prefixLines(OutputWriter &dst, string_view id, string_view text) {
+        while (!text.empty()) {
+            size_t nl = text.find('\n');
+            size_t len = nl == string_view::npos ? text.size() : nl + 1;
+            dst << id << ' ' << text.substr(0, len);
+            text.remove_prefix(len);
+        }
+    }
+
+    OutputWriter &out;
+    mutex outMu; // guards out; taken once per batch
+    deque<Shard> shards;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <bits/stdc++.h>
+using namespace std;
+
+enum class JudgeStatus : uint8_t {
+    Accepted,
+    Wrong_Answer,
+    Runtime_Error,
+    Time_Limit_Exceed
+};
+
+constexpr int kJudgeStatusCount = 4;
+constexpr int kMaxProblems = 26;
+constexpr int kTimeBits = 21; // contest times fit comfortably: T <= 1e5
+
+inline string_view judgeStatusName(JudgeStatus st) {
+    constexpr string_view names[kJudgeStatusCount] = {
+        "Accepted", "Wrong_Answer", "Runtime_Error", "Time_Limit_Exceed"
+    };
+    return names[(int)st];
+}
+
+inline bool toJudgeStatus(string_view s, JudgeStatus &out) {
+    if (s == "Accepted") { out = JudgeStatus::Accepted; return true; }
+    if (s == "Wrong_Answer") { out = JudgeStatus::Wrong_Answer; return true; }
+    if (s == "Runtime_Error") { out = JudgeStatus::Runtime_Error; return true; }
+    if (s == "Time_Limit_Exceed") { out = JudgeStatus::Time_Limit_Exceed; return true; }
+    return false;
+}
+
+struct SubmissionRec {
+    char problem = 0; // 'A'..'Z'
+    JudgeStatus status = JudgeStatus::Accepted;
+    int time = 0; // submission time
+
+    // 32-bit form kept in the query tables: time, status, problem index and a
+    // presence bit, so 0 means "no submission"
+    uint32_t pack() const {
+        return (uint32_t)time | (uint32_t)status << kTimeBits
+             | (uint32_t)(problem - 'A') << (kTimeBits + 2) | 1u << (kTimeBits + 7);
+    }
+
+    static SubmissionRec unpack(uint32_t bits) {
+        SubmissionRec rec;
+        rec.time = (int)(bits & ((1u << kTimeBits) - 1));
+        rec.status = (JudgeStatus)(bits >> kTimeBits & 3);
+        rec.problem = char('A' + (bits >> (kTimeBits + 2) & 31));
+        return rec;
+    }
+};
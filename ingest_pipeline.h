@@ -0,0 +1,323 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include "commands.h"
+#include "contest.h"
+#include "input_reader.h"
+#include "mpsc_queue.h"
+#include "output_writer.h"
+using namespace std;
+
+// Pipelined command processing once the contest has started
+// (--ingest-threads N).
+//
+// A reader thread cuts the input into batches that end at the next FLUSH,
+// FREEZE, SCROLL or END (the barriers), so every line of a batch sees the
+// same flushed ranking; a batch's generation counts the barriers before it.
+// N producer threads tokenize batches and resolve team names (the name table
+// is read-only after START), then push them onto an MPSC queue. The calling
+// thread is the only applier: it puts batches back into input order, applies
+// submissions, runs every other command and writes all replies. When the
+// input runs dry the reader ships what it has at once, and the applier
+// answers it and writes out the journal and the replies.
+//
+// Producers answer QUERY_RANKING from a RankSnapshot, an immutable copy of
+// the flushed ranks that the applier publishes after each barrier. A producer
+// reads it only when the published generation equals its batch's; the next
+// barrier cannot be applied before that batch is, so the snapshot outlives
+// every reader and the applier frees it as soon as its successor is out.
+// Otherwise the applier answers. QUERY_SUBMISSION has to see the submissions
+// right before it, so producers only parse it and the applier answers from
+// the live tables.
+
+struct RankSnapshot {
+    vector<int> flushedRank;
+    bool frozen;
+};
+
+struct IngestCommand {
+    enum Kind : uint8_t { Submit, QueryRanking, QuerySubmission, Other };
+    Kind kind;
+    uint8_t status; // Submit: JudgeStatus
+    bool answered; // reply already written to the batch's replies
+    int team;
+    int a; // Submit: problem index; QuerySubmission: problem filter
+    int b; // Submit: time; QuerySubmission: status filter
+    uint32_t lineBegin, lineEnd; // line within the batch text
+    uint32_t lineIndex; // its line's index in the batch, blank lines included
+    uint32_t replyEnd; // end of the reply in the batch's replies, if answered
+};
+
+struct IngestBatch : MpscNode {
+    uint64_t seq = 0;
+    uint64_t generation = 0;
+    bool endsWithBarrier = false;
+    bool waitsForInput = false; // shipped because the reader is about to block
+    uint64_t firstLine = 0; // input lines before this batch
+    uint32_t lineCount = 0;
+    string text; // the lines, each terminated by '\n'
+    vector<IngestCommand> commands;
+    OutputWriter replies{OutputWriter::kMemory, 256};
+};
+
+class IngestPipeline {
+public:
+    IngestPipeline(Contest &contest, OutputWriter &out, int producers)
+        : contest(contest), out(out), producerCount(max(1, producers)) {}
+
+    IngestPipeline(const IngestPipeline &) = delete;
+    IngestPipeline &operator=(const IngestPipeline &) = delete;
+
+    ~IngestPipeline() { delete snapshot.load(memory_order_relaxed); }
+
+    // Processes the rest of the input, which starts at input line firstLine;
+    // returns the input lines read, after END or at end of input
+    uint64_t run(InputReader &input, uint64_t firstLine) {
+        publish(0);
+        thread reader([&]{ readLoop(input, firstLine); });
+        vector<thread> producers;
+        for (int i = 0; i < producerCount; ++i) producers.emplace_back([this]{ produceLoop(); });
+        applyLoop();
+        if (!submits.empty()) applySubmits(contest, submits); // input ended without END
+        reader.join();
+        for (auto &t : producers) t.join();
+        return linesRead;
+    }
+
+private:
+    static constexpr size_t kBatchLines = 1024;
+    static constexpr size_t kMaxInFlight = 64; // batches between reader and applier
+
+    // ---- reader ----
+
+    void readLoop(InputReader &input, uint64_t lineNo) {
+        uint64_t seq = 0, generation = 0;
+        IngestBatch *batch = nullptr;
+        auto startBatch = [&]{
+            if (batch) return;
+            batch = new IngestBatch;
+            batch->seq = seq++;
+            batch->generation = generation;
+            batch->firstLine = lineNo;
+        };
+        auto ship = [&]{
+            unique_lock<mutex> lk(workMu);
+            roomCv.wait(lk, [&]{ return inFlight < kMaxInFlight; });
+            ++inFlight;
+            work.push_back(batch);
+            lk.unlock();
+            workCv.notify_one();
+            batch = nullptr;
+        };
+        string_view line;
+        for (;;) {
+            if (input.needsRefill()) {
+                // About to wait for input: the applier answers and journals
+                // what has arrived first, even if that is nothing new
+                startBatch();
+                batch->waitsForInput = true;
+                ship();
+            }
+            if (!input.nextLine(line)) break;
+            startBatch();
+            batch->text.append(line.data(), line.size());
+            batch->text.push_back('\n');
+            ++batch->lineCount;
+            ++lineNo;
+            string_view rest, cmd = firstToken(line, rest);
+            bool end = cmd == "END";
+            if (end || cmd == "FLUSH" || cmd == "FREEZE" || cmd == "SCROLL") {
+                batch->endsWithBarrier = true;
+                ++generation;
+                ship();
+                if (end) break;
+            } else if (batch->lineCount == kBatchLines) {
+                ship();
+            }
+        }
+        if (batch) ship();
+        {
+            lock_guard<mutex> lk(workMu);
+            inputDone = true;
+        }
+        workCv.notify_all();
+        linesRead = lineNo;
+        totalBatches.store(seq, memory_order_release);
+        parsedSignal.notifyAll();
+    }
+
+    // ---- producers ----
+
+    void produceLoop() {
+        for (;;) {
+            IngestBatch *batch;
+            {
+                unique_lock<mutex> lk(workMu);
+                workCv.wait(lk, [&]{ return !work.empty() || inputDone; });
+                if (work.empty()) return;
+                batch = work.front();
+                work.pop_front();
+            }
+            parse(*batch);
+            parsed.push(batch);
+            parsedSignal.notify();
+        }
+    }
+
+    void parse(IngestBatch &batch) {
+        const RankSnapshot *snap = nullptr;
+        if (snapshotGeneration.load(memory_order_acquire) == batch.generation) {
+            snap = snapshot.load(memory_order_acquire);
+        }
+        const char *text = batch.text.data();
+        CommandTokens tokens;
+        uint32_t index = 0;
+        for (size_t pos = 0; pos < batch.text.size(); ++index) {
+            size_t nl = (size_t)((const char *)memchr(text + pos, '\n', batch.text.size() - pos) - text);
+            string_view line(text + pos, nl - pos);
+            IngestCommand c{};
+            c.kind = IngestCommand::Other;
+            c.lineBegin = (uint32_t)pos;
+            c.lineEnd = (uint32_t)nl;
+            c.lineIndex = index;
+            pos = nl + 1;
+            tokenize(line, tokens);
+            if (tokens.count == 0) continue;
+            const string_view *tok = tokens.tok;
+            SubmitArgs s;
+            // unknown teams and malformed lines fall through to executeCommand
+            if (parseSubmit(tokens, contest, s)) {
+                c.kind = IngestCommand::Submit;
+                c.team = s.team;
+                c.status = (uint8_t)s.status;
+                c.a = s.problem;
+                c.b = s.time;
+            } else if (tok[0] == "QUERY_RANKING" && tokens.count == 2 && (c.team = contest.findTeam(tok[1])) >= 0) {
+                c.kind = IngestCommand::QueryRanking;
+                if (snap) {
+                    writeRankingReply(batch.replies, tok[1], snap->flushedRank[c.team], snap->frozen);
+                    c.answered = true;
+                    c.replyEnd = (uint32_t)batch.replies.view().size();
+                }
+            } else if (tok[0] == "QUERY_SUBMISSION" && tokens.count >= 6
+                       && (c.team = contest.findTeam(tok[1])) >= 0) {
+                c.kind = IngestCommand::QuerySubmission;
+                parseSubmissionFilter(contest, tok[3].substr(strlen("PROBLEM=")),
+                                      tok[5].substr(strlen("STATUS=")), c.a, c.b);
+            }
+            batch.commands.push_back(c);
+        }
+    }
+
+    // ---- applier ----
+
+    void publish(uint64_t generation) {
+        const RankSnapshot *old = snapshot.load(memory_order_relaxed);
+        const pmr::vector<int> &ranks = contest.flushedRank;
+        snapshot.store(new RankSnapshot{vector<int>(ranks.begin(), ranks.end()), contest.isFrozen},
+                       memory_order_release);
+        snapshotGeneration.store(generation, memory_order_release);
+        delete old;
+    }
+
+    // Next parsed batch in any order, or nullptr once every batch has arrived
+    IngestBatch *waitForBatch(uint64_t applied) {
+        return static_cast<IngestBatch *>(parsedSignal.popOrWait(parsed, [&]{
+            return applied >= totalBatches.load(memory_order_acquire);
+        }));
+    }
+
+    void applyLoop() {
+        vector<IngestBatch *> pending(kMaxInFlight, nullptr); // by seq % kMaxInFlight
+        uint64_t next = 0;
+        bool more = true;
+        while (next < totalBatches.load(memory_order_acquire)) {
+            IngestBatch *arrived = waitForBatch(next);
+            if (!arrived) continue;
+            pending[arrived->seq % kMaxInFlight] = arrived;
+            while (IngestBatch *batch = pending[next % kMaxInFlight]) {
+                pending[next % kMaxInFlight] = nullptr;
+                if (more) more = apply(*batch);
+                delete batch;
+                ++next;
+                {
+                    lock_guard<mutex> lk(workMu);
+                    --inFlight;
+                }
+                roomCv.notify_one();
+            }
+        }
+    }
+
+    // Returns false once END has been handled. The journal is synced as in
+    // the single-threaded loop: before a reply goes out and when the reader
+    // is about to block.
+    bool apply(IngestBatch &batch) {
+        string_view replies = batch.replies.view();
+        size_t replyPos = 0;
+        CommandTokens tokens;
+        EventJournal *journal = contest.journal;
+        for (const IngestCommand &c : batch.commands) {
+            uint64_t line = batch.firstLine + c.lineIndex;
+            if (c.kind == IngestCommand::Submit) {
+                submits.add(c.team, c.a, (JudgeStatus)c.status, c.b);
+                if (submits.full()) {
+                    applySubmits(contest, submits);
+                    if (journal && journal->snapshotDue()) journal->sync(contest, line + 1);
+                }
+                continue;
+            }
+            if (!submits.empty()) applySubmits(contest, submits);
+            if (journal && journal->unsynced()) journal->sync(contest, line);
+            switch (c.kind) {
+            case IngestCommand::Submit: // collected above
+                break;
+            case IngestCommand::QueryRanking:
+                if (c.answered) {
+                    out.put(replies.substr(replyPos, c.replyEnd - replyPos));
+                    replyPos = c.replyEnd;
+                } else {
+                    writeRankingReply(out, contest.teamName(c.team), contest.flushedRank[c.team], contest.isFrozen);
+                }
+                break;
+            case IngestCommand::QuerySubmission:
+                writeSubmissionReply(contest, out, c.team, c.a, c.b);
+                break;
+            case IngestCommand::Other:
+                tokenize(string_view(batch.text).substr(c.lineBegin, c.lineEnd - c.lineBegin), tokens);
+                if (!executeCommand(contest, out, tokens)) return false;
+                if (journal && journal->snapshotDue()) journal->sync(contest, line + 1);
+                break;
+            }
+        }
+        if (batch.endsWithBarrier) publish(batch.generation + 1);
+        if (batch.waitsForInput) {
+            if (!submits.empty()) applySubmits(contest, submits);
+            if (journal) journal->sync(contest, batch.firstLine + batch.lineCount);
+            out.flush();
+        }
+        return true;
+    }
+
+    Contest &contest;
+    OutputWriter &out;
+    int producerCount;
+    SubmitBatch submits; // applier only
+
+    // reader -> producers
+    mutex workMu;
+    condition_variable workCv, roomCv;
+    deque<IngestBatch *> work;
+    size_t inFlight = 0; // shipped and not yet applied
+    bool inputDone = false;
+
+    // producers -> applier
+    MpscQueue parsed;
+    MpscSignal parsedSignal;
+    atomic<uint64_t> totalBatches{UINT64_MAX};
+    uint64_t linesRead = 0; // published with totalBatches
+
+    // ranking published by the applier
+    atomic<const RankSnapshot *> snapshot{nullptr};
+    atomic<uint64_t> snapshotGeneration{0};
+};
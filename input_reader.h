@@ -0,0 +1,118 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// Buffered stdin reader handing out one line at a time as a view into its
+// buffer. A regular file is mapped whole; pipes are read in large chunks.
+class InputReader {
+public:
+    InputReader() {
+        struct stat st;
+        if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                mapped = static_cast<const char *>(p);
+                mappedSize = (size_t)st.st_size;
+                begin = mapped;
+                end = mapped + mappedSize;
+                eof = true;
+                return;
+            }
+        }
+        buffer.resize(kChunk);
+        begin = end = buffer.data();
+    }
+
+    ~InputReader() {
+        if (mapped) munmap(const_cast<char *>(mapped), mappedSize);
+    }
+
+    InputReader(const InputReader &) = delete;
+    InputReader &operator=(const InputReader &) = delete;
+
+    // Next line without its terminator; the view stays valid until the next call
+    bool nextLine(string_view &line) {
+        for (;;) {
+            const char *nl = static_cast<const char *>(memchr(begin, '\n', (size_t)(end - begin)));
+            if (nl) {
+                line = string_view(begin, (size_t)(nl - begin));
+                begin = nl + 1;
+                return true;
+            }
+            if (eof) {
+                if (begin == end) return false;
+                line = string_view(begin, (size_t)(end - begin));
+                begin = end;
+                return true;
+            }
+            refill();
+        }
+    }
+
+    // True when the next nextLine() has to read stdin first, which may block
+    bool needsRefill() const {
+        return !eof && !memchr(begin, '\n', (size_t)(end - begin));
+    }
+
+private:
+    static constexpr size_t kChunk = 1 << 20;
+
+    void refill() {
+        size_t pending = (size_t)(end - begin);
+        if (pending == buffer.size()) buffer.resize(buffer.size() * 2); // line longer than buffer
+        memmove(buffer.data(), begin, pending);
+        begin = buffer.data();
+        end = begin + pending;
+        ssize_t n;
+        do {
+            n = read(STDIN_FILENO, buffer.data() + pending, buffer.size() - pending);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) eof = true;
+        else end += n;
+    }
+
+    vector<char> buffer;
+    const char *mapped = nullptr;
+    size_t mappedSize = 0;
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    bool eof = false;
+};
+
+// Whitespace-separated tokens of one command line, as views into the line
+struct CommandTokens {
+    static constexpr int kMaxTokens = 8; // SUBMIT has the most: 8
+    string_view tok[kMaxTokens];
+    int count = 0;
+};
+
+// First whitespace-separated token of line (empty if there is none); rest
+// is what follows it
+inline string_view firstToken(string_view line, string_view &rest) {
+    size_t i = 0, n = line.size();
+    while (i < n && isspace((unsigned char)line[i])) ++i;
+    size_t j = i;
+    while (j < n && !isspace((unsigned char)line[j])) ++j;
+    rest = line.substr(j);
+    return line.substr(i, j - i);
+}
+
+inline void tokenize(string_view line, CommandTokens &out) {
+    out.count = 0;
+    while (out.count < CommandTokens::kMaxTokens) {
+        string_view tok = firstToken(line, line);
+        if (tok.empty()) break;
+        out.tok[out.count++] = tok;
+    }
+}
+
+inline int parseInt(string_view s) {
+    int v = 0;
+    for (char c : s) v = v * 10 + (c - '0');
+    return v;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Rendered scoreboard line tails, "solved penalty cells...\n" without the
+// team name and rank, one per team in a shared text pool. A touched team is
+// stale until its tail is stored again. Each tail sits in a slot with a few
+// bytes of room, so the usual re-render (a cell gaining a digit or a sign)
+// is written over the old text; a tail that outgrows its slot moves to the
+// end of the pool and leaves garbage. The pool is a list of fixed blocks that
+// are never reallocated; rather than add a block while garbage exceeds a
+// quarter of the live slots, the pool is compacted in place.
+class TeamLineCache {
+public:
+    explicit TeamLineCache(pmr::memory_resource *memory)
+        : blocks(memory), offset(memory), length(memory), room(memory), stale(memory), staleList(memory),
+          changed(memory) {}
+
+    // Every team starts out stale; the pool fills on the first print
+    void reset(int teams) {
+        blocks.clear();
+        poolEnd = 0;
+        liveBytes = 0;
+        offset.assign(teams, 0);
+        length.assign(teams, 0);
+        room.assign(teams, 0);
+        stale.assign(bitWords(teams), ~0ULL);
+        staleList.resize(teams);
+        iota(staleList.begin(), staleList.end(), 0);
+        changed.assign(bitWords(teams), ~0ULL);
+    }
+
+    void touch(int ti) {
+        if (!testBit(stale, ti)) {
+            setBit(stale, ti);
+            staleList.push_back(ti);
+        }
+    }
+
+    const pmr::vector<int> &staleTeams() const { return staleList; }
+    bool isStale(int ti) const { return testBit(stale, ti); }
+
+    void prefetch(int ti) const { __builtin_prefetch(&stale[ti >> 6], 1); }
+
+    // A tail equal to the one held keeps its text and does not count as a
+    // change
+    void store(int ti, string_view tail) {
+        clearBit(stale, ti);
+        if (tail == this->tail(ti)) return;
+        setBit(changed, ti);
+        length[ti] = (uint16_t)tail.size();
+        if (tail.size() > room[ti]) {
+            uint32_t slot = (uint32_t)tail.size() + kSlotRoom;
+            uint32_t at = slotAfter(poolEnd, slot);
+            if ((at >> kBlockBits) == blocks.size() && poolEnd - liveBytes > liveBytes / 4) {
+                compact();
+                at = slotAfter(poolEnd, slot);
+            }
+            if ((at >> kBlockBits) == blocks.size()) blocks.emplace_back(kBlockBytes);
+            liveBytes += slot - room[ti];
+            offset[ti] = at;
+            room[ti] = (uint16_t)slot;
+            poolEnd = at + slot;
+        }
+        memcpy(textAt(offset[ti]), tail.data(), tail.size());
+    }
+
+    // After every stale team has been stored again
+    void clearStale() { staleList.clear(); }
+
+    string_view tail(int ti) const {
+        return room[ti] ? string_view(textAt(offset[ti]), length[ti]) : string_view();
+    }
+
+    // Re-rendered since the last markPrinted (for diff output)
+    bool changedSincePrint(int ti) const { return testBit(changed, ti); }
+    void markPrinted(int ti) { clearBit(changed, ti); }
+
+private:
+    static constexpr uint32_t kSlotRoom = 4;
+    static constexpr int kBlockBits = 16;
+    static constexpr uint32_t kBlockBytes = 1u << kBlockBits;
+
+    static size_t bitWords(int teams) { return ((size_t)teams + 63) / 64; }
+    static bool testBit(const pmr::vector<uint64_t> &bits, int i) { return bits[i >> 6] >> (i & 63) & 1; }
+    static void setBit(pmr::vector<uint64_t> &bits, int i) { bits[i >> 6] |= 1ULL << (i & 63); }
+    static void clearBit(pmr::vector<uint64_t> &bits, int i) { bits[i >> 6] &= ~(1ULL << (i & 63)); }
+
+    const char *textAt(uint32_t at) const { return blocks[at >> kBlockBits].data() + (at & (kBlockBytes - 1)); }
+    char *textAt(uint32_t at) { return blocks[at >> kBlockBits].data() + (at & (kBlockBytes - 1)); }
+
+    // Where a slot of the given size goes at or after `at`: slots never
+    // straddle two blocks
+    static uint32_t slotAfter(uint32_t at, uint32_t slot) {
+        if ((at & (kBlockBytes - 1)) + slot > kBlockBytes) at = (at | (kBlockBytes - 1)) + 1;
+        return at;
+    }
+
+    // In place, so the blocks are reused rather than reallocated: slots slide
+    // down in pool order, and since they are placed as tightly as before,
+    // every one moves to or below where it was
+    void compact() {
+        vector<int> byOffset;
+        byOffset.reserve(offset.size());
+        for (size_t ti = 0; ti < offset.size(); ++ti) {
+            if (room[ti]) byOffset.push_back((int)ti);
+        }
+        sort(byOffset.begin(), byOffset.end(), [&](int a, int b){ return offset[a] < offset[b]; });
+        uint32_t to = 0;
+        for (int ti : byOffset) {
+            to = slotAfter(to, room[ti]);
+            memmove(textAt(to), textAt(offset[ti]), length[ti]);
+            offset[ti] = to;
+            to += room[ti];
+        }
+        poolEnd = to;
+    }
+
+    pmr::vector<pmr::vector<char>> blocks; // kBlockBytes each
+    uint32_t poolEnd = 0; // where the next slot goes
+    uint32_t liveBytes = 0; // bytes in the slots teams hold
+    pmr::vector<uint32_t> offset; // slot start in text
+    pmr::vector<uint16_t> length; // tail bytes, at most room
+    pmr::vector<uint16_t> room; // slot bytes, 0 before the first store
+    pmr::vector<uint64_t> stale; // bit per team
+    pmr::vector<int> staleList;
+    pmr::vector<uint64_t> changed; // bit per team
+};
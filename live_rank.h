@@ -0,0 +1,57 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include "rank_order.h"
+using namespace std;
+
+// Real-time ranks for QUERY_LIVE_RANKING: every team in an order-statistic
+// tree by its current visible rank key, so a team's rank is the number of
+// teams ahead of it plus one. The tree keeps its own copy of the keys, since
+// the contest's cached keys only move at FLUSH; the contest reports every
+// change of a team's visible key through update().
+class LiveRankIndex {
+public:
+    virtual ~LiveRankIndex() = default;
+
+    // key: the team's current visible key, in the contest's key width
+    virtual void update(int ti, const uint64_t *key) = 0;
+
+    virtual int rank(int ti) const = 0;
+};
+
+template <int W>
+class LiveRankTree : public LiveRankIndex {
+public:
+    // keyOf(ti, key) writes team ti's current visible key
+    template <class KeyOf>
+    LiveRankTree(int teams, KeyOf keyOf) : keys((size_t)teams * W), tree(KeyLess{keys.data()}) {
+        for (int ti = 0; ti < teams; ++ti) {
+            keyOf(ti, &keys[(size_t)ti * W]);
+            tree.insert(ti);
+        }
+    }
+
+    void update(int ti, const uint64_t *key) override {
+        uint64_t *current = &keys[(size_t)ti * W];
+        if (PackedRankKey::equal<W>(key, current)) return;
+        tree.erase(ti); // found by its old key
+        memcpy(current, key, W * sizeof(uint64_t));
+        tree.insert(ti);
+    }
+
+    int rank(int ti) const override { return (int)tree.order_of_key(ti) + 1; }
+
+private:
+    struct KeyLess {
+        const uint64_t *keys;
+        bool operator()(int a, int b) const {
+            return PackedRankKey::less<W>(keys + (size_t)a * W, keys + (size_t)b * W);
+        }
+    };
+
+    vector<uint64_t> keys; // sized once, so KeyLess can hold its data pointer
+    __gnu_pbds::tree<int, __gnu_pbds::null_type, KeyLess, __gnu_pbds::rb_tree_tag,
+                     __gnu_pbds::tree_order_statistics_node_update> tree;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Intrusive multi-producer / single-consumer queue (Vyukov). push() is one
+// atomic exchange and never blocks; pop() belongs to a single consumer
+// thread. Nodes derive from MpscNode and stay owned by the caller.
+struct MpscNode {
+    atomic<MpscNode *> next{nullptr};
+};
+
+class MpscQueue {
+public:
+    MpscQueue() : head(&stub), tail(&stub) {}
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    void push(MpscNode *n) {
+        n->next.store(nullptr, memory_order_relaxed);
+        MpscNode *prev = head.exchange(n, memory_order_acq_rel);
+        prev->next.store(n, memory_order_release);
+    }
+
+    // Oldest node, or nullptr when the queue is empty or a push is still
+    // halfway done (the caller simply tries again later)
+    MpscNode *pop() {
+        MpscNode *t = tail;
+        MpscNode *next = t->next.load(memory_order_acquire);
+        if (t == &stub) {
+            if (!next) return nullptr;
+            tail = t = next;
+            next = t->next.load(memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return t;
+        }
+        if (t != head.load(memory_order_acquire)) return nullptr;
+        // t is the last node: park the stub behind it so t can be handed out
+        push(&stub);
+        next = t->next.load(memory_order_acquire);
+        if (!next) return nullptr;
+        tail = next;
+        return t;
+    }
+
+private:
+    atomic<MpscNode *> head; // producers append here
+    MpscNode *tail; // consumer side
+    MpscNode stub;
+};
+
+// Lets the consumer of an MpscQueue sleep while it is empty. Producers call
+// notify() after each push; the consumer pops through popOrWait(), which
+// spins briefly and then sleeps until a node arrives or stop() holds.
+class MpscSignal {
+public:
+    void notify() {
+        atomic_thread_fence(memory_order_seq_cst); // pairs with the fence in popOrWait
+        if (waiting.load(memory_order_relaxed)) {
+            lock_guard<mutex> lk(mu);
+            cv.notify_one();
+        }
+    }
+
+    // After changing state that stop() reads
+    void notifyAll() {
+        lock_guard<mutex> lk(mu);
+        cv.notify_all();
+    }
+
+    // Next node, or nullptr once the queue is empty and stop() holds
+    template <class Stop>
+    MpscNode *popOrWait(MpscQueue &q, Stop stop) {
+        MpscNode *n = q.pop();
+        for (int i = 0; !n && i < kSpins; ++i) {
+            this_thread::yield();
+            n = q.pop();
+        }
+        if (n) return n;
+        unique_lock<mutex> lk(mu);
+        waiting.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        cv.wait(lk, [&]{ return (n = q.pop()) != nullptr || stop(); });
+        waiting.store(false, memory_order_relaxed);
+        return n;
+    }
+
+private:
+    static constexpr int kSpins = 64;
+
+    mutex mu;
+    condition_variable cv;
+    atomic<bool> waiting{false};
+};
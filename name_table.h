@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Team names interned into one contiguous arena, looked up through an
+// open-addressing hash table (linear probing, load factor at most 1/2).
+class NameTable {
+public:
+    explicit NameTable(pmr::memory_resource *memory = pmr::get_default_resource())
+        : chars(memory), offsets(1, 0, memory), slots(memory) {}
+
+    int size() const { return (int)offsets.size() - 1; }
+
+    // The view is invalidated by the next insert
+    string_view name(int id) const {
+        return string_view(chars.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    // Id of the name, or -1 if it was never inserted
+    int find(string_view key) const {
+        if (slots.empty()) return -1;
+        size_t mask = slots.size() - 1;
+        for (size_t i = hashOf(key) & mask;; i = (i + 1) & mask) {
+            int id = slots[i];
+            if (id < 0) return -1;
+            if (name(id) == key) return id;
+        }
+    }
+
+    // Id of the new name, or -1 if it is already present
+    int insert(string_view key) {
+        if (find(key) >= 0) return -1;
+        if ((size_t)(size() + 1) * 2 > slots.size()) rehash(max<size_t>(16, slots.size() * 2));
+        int id = size();
+        chars.insert(chars.end(), key.begin(), key.end());
+        offsets.push_back((uint32_t)chars.size());
+        place(id);
+        return id;
+    }
+
+    // Raw arrays, for snapshots; restore() takes them back unchanged
+    const pmr::vector<char> &arena() const { return chars; }
+    const pmr::vector<uint32_t> &arenaOffsets() const { return offsets; }
+    const pmr::vector<int> &hashSlots() const { return slots; }
+
+    void restore(const pmr::vector<char> &c, const pmr::vector<uint32_t> &o, const pmr::vector<int> &s) {
+        chars = c;
+        offsets = o;
+        slots = s;
+    }
+
+private:
+    static size_t hashOf(string_view key) {
+        uint64_t h = 1469598103934665603ULL; // FNV-1a
+        for (char c : key) { h ^= (unsigned char)c; h *= 1099511628211ULL; }
+        return (size_t)(h ^ (h >> 29));
+    }
+
+    void place(int id) {
+        size_t mask = slots.size() - 1;
+        size_t i = hashOf(name(id)) & mask;
+        while (slots[i] >= 0) i = (i + 1) & mask;
+        slots[i] = id;
+    }
+
+    void rehash(size_t capacity) {
+        slots.assign(capacity, -1);
+        for (int id = 0; id < size(); ++id) place(id);
+    }
+
+    pmr::vector<char> chars;
+    pmr::vector<uint32_t> offsets; // name i spans chars[offsets[i], offsets[i + 1]), offsets[0] == 0
+    pmr::vector<int> slots; // team ids, -1 for empty
+};
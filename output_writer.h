@@ -0,0 +1,93 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include <unistd.h>
+using namespace std;
+
+// Output engine: one byte buffer written to the fd in large chunks, with
+// hand-rolled integer formatting so scoreboard cells need no temporaries.
+// With fd == kMemory the buffer just grows and is read back through view().
+class OutputWriter {
+public:
+    static constexpr int kMemory = -1;
+
+    explicit OutputWriter(int fd = STDOUT_FILENO, size_t capacity = kCapacity) : fd(fd), buf(capacity) {}
+    ~OutputWriter() { flush(); }
+
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+
+    void put(char c) {
+        *reserve(1) = c;
+        ++len;
+    }
+
+    void put(string_view s) {
+        char *dst = reserve(s.size());
+        memcpy(dst, s.data(), s.size());
+        len += s.size();
+    }
+
+    void putInt(long long v) {
+        char tmp[24];
+        int n = 0;
+        unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+        do { tmp[n++] = char('0' + u % 10); u /= 10; } while (u);
+        char *dst = reserve((size_t)n + 1);
+        if (v < 0) { *dst++ = '-'; ++len; }
+        while (n) { *dst++ = tmp[--n]; ++len; }
+    }
+
+    OutputWriter &operator<<(char c) { put(c); return *this; }
+    OutputWriter &operator<<(string_view s) { put(s); return *this; }
+    OutputWriter &operator<<(const char *s) { put(string_view(s)); return *this; }
+    OutputWriter &operator<<(int v) { putInt(v); return *this; }
+    OutputWriter &operator<<(long long v) { putInt(v); return *this; }
+
+    string_view view() const { return string_view(buf.data(), len); }
+
+    // Drops the buffered bytes; a memory writer keeps its capacity
+    void clear() { len = 0; }
+
+    // Bytes produced so far, flushed or still buffered
+    uint64_t bytesWritten() const { return flushedBytes + len; }
+
+    void flush() {
+        if (fd == kMemory) return;
+        flushedBytes += len;
+        const char *p = buf.data();
+        size_t left = len;
+        while (left > 0) {
+            ssize_t n = write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break; // nowhere to report it; drop the rest
+            }
+            p += n;
+            left -= (size_t)n;
+        }
+        len = 0;
+    }
+
+private:
+    static constexpr size_t kCapacity = 1 << 20;
+
+    // Room for n more bytes at buf[len]; a file-backed writer grows only for
+    // a single oversized write
+    char *reserve(size_t n) {
+        if (len + n > buf.size()) {
+            if (fd == kMemory) {
+                buf.resize(max(buf.size() * 2, len + n));
+            } else {
+                flush();
+                if (n > buf.size()) buf.resize(n);
+            }
+        }
+        return buf.data() + len;
+    }
+
+    int fd;
+    vector<char> buf;
+    size_t len = 0;
+    uint64_t flushedBytes = 0;
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include "rank_order.h"
+using namespace std;
+
+// Past flushed rankings for QUERY_RANKING team AT t (--rank-history).
+//
+// A version is recorded at START (or when a snapshot restore starts a new
+// history) and at every FREEZE, FLUSH or SCROLL that changes the board or its
+// frozen state: a persistent treap of all teams ordered by rank key, sharing
+// every subtree that did not change with the version before (path copying).
+// Nodes made while recording the current version are updated in place, so a
+// version costs O(log N) new nodes per changed team and nothing per unchanged
+// one.
+// Versions are stamped with the contest clock, the latest submission time
+// applied so far. A query takes the last version stamped at or before t,
+// binary-searches the team's own list of key changes for its key in that
+// version, and counts the keys ahead of it, all in O(log N).
+class RankHistory {
+public:
+    virtual ~RankHistory() = default;
+
+    void advanceClock(int time) { clock = max(clock, time); }
+
+    // changed[0, count): teams whose key may differ from their last recorded
+    // one; keys: the contest's cached keys, in its key width; frozen: whether
+    // the board is frozen from now on
+    virtual void record(const int *changed, size_t count, const uint64_t *keys, bool frozen) = 0;
+
+    // Rank of team ti on the board as flushed at time t; false if the
+    // history does not reach back that far
+    virtual bool rankAt(int ti, int t, int &rank, bool &frozen) const = 0;
+
+protected:
+    int clock = 0;
+};
+
+template <int W>
+class RankHistoryTree : public RankHistory {
+public:
+    // order: every team, best first; keys as in record(). The board it
+    // holds is the first version, stamped with contest time `since`.
+    RankHistoryTree(const pmr::vector<int> &order, const uint64_t *keys, int since, bool frozen) {
+        size_t n = order.size();
+        recordKeys.assign(keys, keys + n * W);
+        changes.resize(n);
+        // Cartesian tree over the sorted order: a treap with random
+        // priorities, built in O(N)
+        nodes.reserve(2 * n + 1);
+        nodes.push_back(Node{});
+        vector<uint32_t> spine;
+        for (int ti : order) {
+            uint32_t x = newNode((uint32_t)ti);
+            uint32_t last = 0;
+            while (!spine.empty() && nodes[spine.back()].priority < nodes[x].priority) {
+                last = spine.back();
+                spine.pop_back();
+                pull(last);
+            }
+            nodes[x].left = last;
+            if (!spine.empty()) nodes[spine.back()].right = x;
+            spine.push_back(x);
+        }
+        uint32_t root = spine.empty() ? 0 : spine.front();
+        while (!spine.empty()) {
+            pull(spine.back());
+            spine.pop_back();
+        }
+        clock = since;
+        versions.push_back(Version{root, since, frozen});
+    }
+
+    void record(const int *changed, size_t count, const uint64_t *keys, bool frozen) override {
+        stamp = (uint32_t)versions.size();
+        uint32_t root = versions.back().root;
+        for (size_t i = 0; i < count; ++i) {
+            int ti = changed[i];
+            const uint64_t *key = keys + (size_t)ti * W;
+            uint32_t last = latest(ti);
+            if (PackedRankKey::equal<W>(key, keyOf(last))) continue;
+            root = erase(root, keyOf(last));
+            uint32_t rec = (uint32_t)(recordKeys.size() / W);
+            recordKeys.insert(recordKeys.end(), key, key + W);
+            changes[ti].push_back(KeyChange{stamp, rec});
+            auto [below, rest] = split(root, key);
+            root = merge(merge(below, newNode(rec)), rest);
+        }
+        // an unchanged board is still the previous version
+        if (root != versions.back().root || frozen != versions.back().frozen) {
+            versions.push_back(Version{root, clock, frozen});
+        }
+    }
+
+    bool rankAt(int ti, int t, int &rank, bool &frozen) const override {
+        auto it = upper_bound(versions.begin(), versions.end(), t,
+                              [](int t, const Version &v){ return t < v.clock; });
+        if (it == versions.begin()) return false;
+        const Version &v = *prev(it);
+        uint32_t version = (uint32_t)(prev(it) - versions.begin());
+        const vector<KeyChange> &mine = changes[ti];
+        auto change = upper_bound(mine.begin(), mine.end(), version,
+                                  [](uint32_t at, const KeyChange &c){ return at < c.version; });
+        uint32_t rec = change == mine.begin() ? (uint32_t)ti : prev(change)->record;
+        // Teams ahead: keys smaller than the team's own
+        const uint64_t *key = keyOf(rec);
+        int ahead = 0;
+        for (uint32_t x = v.root; x;) {
+            if (PackedRankKey::less<W>(keyOf(nodes[x].record), key)) {
+                ahead += nodes[nodes[x].left].size + 1;
+                x = nodes[x].right;
+            } else {
+                x = nodes[x].left;
+            }
+        }
+        rank = ahead + 1;
+        frozen = v.frozen;
+        return true;
+    }
+
+private:
+    // The key record a team holds from version `version` on
+    struct KeyChange {
+        uint32_t version;
+        uint32_t record;
+    };
+
+    struct Node {
+        uint32_t left = 0, right = 0, size = 0;
+        uint32_t record = 0;
+        uint32_t priority = 0;
+        uint32_t stamp = 0; // version that made it; only that one may change it
+    };
+
+    struct Version {
+        uint32_t root;
+        int clock;
+        bool frozen;
+    };
+
+    const uint64_t *keyOf(uint32_t rec) const { return &recordKeys[(size_t)rec * W]; }
+
+    uint32_t latest(int ti) const { return changes[ti].empty() ? (uint32_t)ti : changes[ti].back().record; }
+
+    uint32_t newNode(uint32_t rec) {
+        Node x;
+        x.size = 1;
+        x.record = rec;
+        x.priority = (uint32_t)rng();
+        x.stamp = stamp;
+        nodes.push_back(x);
+        return (uint32_t)nodes.size() - 1;
+    }
+
+    // x itself if the current version made it, otherwise a copy
+    uint32_t own(uint32_t x) {
+        if (nodes[x].stamp == stamp) return x;
+        Node c = nodes[x];
+        c.stamp = stamp;
+        nodes.push_back(c);
+        return (uint32_t)nodes.size() - 1;
+    }
+
+    void pull(uint32_t x) { nodes[x].size = nodes[nodes[x].left].size + nodes[nodes[x].right].size + 1; }
+
+    // Keys below key / the rest
+    pair<uint32_t, uint32_t> split(uint32_t x, const uint64_t *key) {
+        if (!x) return {0, 0};
+        x = own(x);
+        if (PackedRankKey::less<W>(keyOf(nodes[x].record), key)) {
+            auto [l, r] = split(nodes[x].right, key);
+            nodes[x].right = l;
+            pull(x);
+            return {x, r};
+        }
+        auto [l, r] = split(nodes[x].left, key);
+        nodes[x].left = r;
+        pull(x);
+        return {l, x};
+    }
+
+    // Every key in a is below every key in b
+    uint32_t merge(uint32_t a, uint32_t b) {
+        if (!a || !b) return a | b;
+        if (nodes[a].priority > nodes[b].priority) {
+            a = own(a);
+            uint32_t r = merge(nodes[a].right, b);
+            nodes[a].right = r;
+            pull(a);
+            return a;
+        }
+        b = own(b);
+        uint32_t l = merge(a, nodes[b].left);
+        nodes[b].left = l;
+        pull(b);
+        return b;
+    }
+
+    // key must be present
+    uint32_t erase(uint32_t x, const uint64_t *key) {
+        if (PackedRankKey::equal<W>(keyOf(nodes[x].record), key)) return merge(nodes[x].left, nodes[x].right);
+        x = own(x);
+        if (PackedRankKey::less<W>(key, keyOf(nodes[x].record))) {
+            uint32_t l = erase(nodes[x].left, key);
+            nodes[x].left = l;
+        } else {
+            uint32_t r = erase(nodes[x].right, key);
+            nodes[x].right = r;
+        }
+        pull(x);
+        return x;
+    }
+
+    vector<Node> nodes; // nodes[0] is the empty tree
+    vector<uint64_t> recordKeys; // W words per key record; record ti is team ti's key at START
+    vector<vector<KeyChange>> changes; // per team, by version; none before its first change
+    vector<Version> versions;
+    uint32_t stamp = 0;
+    mt19937 rng{20240917};
+};
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include "contest_types.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+// Visible rank of a team as fixed-width words compared lexicographically;
+// smaller means ranked higher. Word 0 holds (31 - solved) above the penalty,
+// the next words hold the solve times in descending order, three kTimeBits
+// fields per word, and the last word is the team's name ordinal, which makes
+// every key unique. A contest with M problems needs rankKeyWords(M) words,
+// so keys are stored flat at that stride and the code that builds and
+// compares them is instantiated per word count (withRankKeyWords).
+constexpr int kRankKeyTimesPerWord = 3;
+
+constexpr int rankKeyWords(int problems) {
+    return 2 + (problems + kRankKeyTimesPerWord - 1) / kRankKeyTimesPerWord;
+}
+
+struct PackedRankKey {
+    static constexpr int kPenaltyBits = 59;
+    static constexpr int kMinWords = rankKeyWords(1);
+    static constexpr int kMaxWords = rankKeyWords(kMaxProblems);
+
+    // Solve-time fields in a W-word key
+    static constexpr int timeFields(int W) { return (W - 2) * kRankKeyTimesPerWord; }
+
+    // timesDesc holds every time field, largest first; unsolved fields are 0
+    template <int W>
+    static void make(uint64_t *w, int solved, long long penalty, const int *timesDesc, int ordinal) {
+        w[0] = ((uint64_t)(31 - solved) << kPenaltyBits) | (uint64_t)penalty;
+        for (int i = 1; i < W - 1; ++i) {
+            const int *t = timesDesc + (i - 1) * kRankKeyTimesPerWord;
+            w[i] = (uint64_t)t[0] << 2 * kTimeBits | (uint64_t)t[1] << kTimeBits | (uint64_t)t[2];
+        }
+        w[W - 1] = (uint64_t)ordinal;
+    }
+
+    static int solved(const uint64_t *w) { return 31 - (int)(w[0] >> kPenaltyBits); }
+    static long long penalty(const uint64_t *w) { return (long long)(w[0] & ((1ULL << kPenaltyBits) - 1)); }
+
+    template <int W>
+    static bool less(const uint64_t *a, const uint64_t *b) {
+        // solved and penalty settle nearly every comparison
+        if (a[0] != b[0]) return a[0] < b[0];
+        int i = 1;
+#ifdef __SSE2__
+        // Ties: find the first differing word two at a time
+        for (; i + 2 <= W; i += 2) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+            unsigned same = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi32(x, y));
+            if (same != 0xffff) {
+                int j = i + (__builtin_ctz(~same) >> 3);
+                return a[j] < b[j];
+            }
+        }
+#endif
+        for (; i < W; ++i) {
+            if (a[i] != b[i]) return a[i] < b[i];
+        }
+        return false;
+    }
+
+    template <int W>
+    static bool equal(const uint64_t *a, const uint64_t *b) { return memcmp(a, b, W * sizeof(uint64_t)) == 0; }
+};
+
+// Calls f(integral_constant<int, W>) for a key width from rankKeyWords
+template <class F>
+decltype(auto) withRankKeyWords(int words, F f) {
+    switch (words) {
+    case 3: return f(integral_constant<int, 3>());
+    case 4: return f(integral_constant<int, 4>());
+    case 5: return f(integral_constant<int, 5>());
+    case 6: return f(integral_constant<int, 6>());
+    case 7: return f(integral_constant<int, 7>());
+    case 8: return f(integral_constant<int, 8>());
+    case 9: return f(integral_constant<int, 9>());
+    case 10: return f(integral_constant<int, 10>());
+    default: return f(integral_constant<int, PackedRankKey::kMaxWords>());
+    }
+}
+static_assert(PackedRankKey::kMinWords == 3 && PackedRankKey::kMaxWords == 11, "update withRankKeyWords");
+
+// Batcher's odd-even merge sort network for N elements. Comparators that
+// reach past N are dropped, which is exact when the missing elements count
+// as smaller than all others.
+template <int N>
+struct SortingNetwork {
+    struct Comparator {
+        int hi, lo; // hi < lo; the larger value ends up at index hi
+    };
+
+    // Writes the comparators to out (when given) and returns their count
+    static constexpr int build(Comparator *out) {
+        int width = 1;
+        while (width < N) width <<= 1;
+        int count = 0;
+        for (int p = 1; p < width; p <<= 1) {
+            for (int k = p; k >= 1; k >>= 1) {
+                for (int j = k % p; j + k < width; j += 2 * k) {
+                    for (int i = 0; i < k && i + j + k < width; ++i) {
+                        int a = i + j, b = i + j + k;
+                        if (a / (2 * p) != b / (2 * p) || b >= N) continue;
+                        if (out) out[count] = Comparator{a, b};
+                        ++count;
+                    }
+                }
+            }
+        }
+        return count;
+    }
+
+    static constexpr int kSize = build(nullptr);
+
+    struct Comparators {
+        Comparator at[kSize > 0 ? kSize : 1] = {};
+        constexpr Comparators() { build(at); }
+    };
+    static constexpr Comparators kComparators{};
+
+    // Largest first, without data-dependent branches
+    static void sortDescending(int *v) {
+        for (int c = 0; c < kSize; ++c) {
+            int &x = v[kComparators.at[c].hi], &y = v[kComparators.at[c].lo];
+            int larger = max(x, y), smaller = min(x, y);
+            x = larger;
+            y = smaller;
+        }
+    }
+};
+
+// Sorts v[0, N) largest first when only v[0, count) can be non-zero and no
+// value is negative: the zeros already sit at the tail, so the smallest
+// network covering count is enough
+template <int N>
+void sortTimesDescending(int *v, int count) {
+    if (N > 4 && count <= 4) SortingNetwork<min(N, 4)>::sortDescending(v);
+    else if (N > 8 && count <= 8) SortingNetwork<min(N, 8)>::sortDescending(v);
+    else if (N > 16 && count <= 16) SortingNetwork<min(N, 16)>::sortDescending(v);
+    else SortingNetwork<N>::sortDescending(v);
+}
+
+// A team in a BlockedRankList. The leading key word (solved and penalty)
+// sits inline so nearly every comparison stays inside the block; ties fall
+// back to the team's full key.
+struct RankEntry {
+    uint64_t head;
+    int team;
+};
+
+// Ordered set of teams by W-word rank keys, kept as a list of sorted blocks
+// (a two-level B-tree): lookups binary-search the block tails and then one
+// block, and updates move at most a couple of blocks' worth of contiguous
+// entries. A team's key must not change while it is in the list.
+template <int W>
+class BlockedRankList {
+public:
+    // Team ti's key is keys[ti * W, ti * W + W)
+    explicit BlockedRankList(const uint64_t *keys) : keys(keys) {}
+
+    // Bulk load: entries must arrive in increasing key order
+    void pushBack(const RankEntry &e) {
+        if (blocks.empty() || blocks.back().size() == kBlock) {
+            blocks.emplace_back();
+            blocks.back().reserve(kBlock);
+        }
+        blocks.back().push_back(e);
+    }
+
+    bool empty() const { return blocks.empty(); }
+    const RankEntry &back() const { return blocks.back().back(); }
+
+    void insert(const RankEntry &e) {
+        if (blocks.empty()) {
+            blocks.emplace_back(1, e);
+            return;
+        }
+        size_t b = min(blockFor(e), blocks.size() - 1);
+        auto &blk = blocks[b];
+        blk.insert(lowerBound(blk, e), e);
+        if (blk.size() > 2 * kBlock) {
+            blocks.emplace(blocks.begin() + b + 1, blk.begin() + kBlock, blk.end());
+            blocks[b].resize(kBlock);
+        }
+    }
+
+    // e must be present
+    void erase(const RankEntry &e) {
+        size_t b = blockFor(e);
+        auto &blk = blocks[b];
+        blk.erase(lowerBound(blk, e));
+        if (blk.empty()) blocks.erase(blocks.begin() + b);
+    }
+
+    // Entry ranked directly above / below e (which must be present), or
+    // nullptr at either end
+    const RankEntry *before(const RankEntry &e) const {
+        size_t b = blockFor(e);
+        const auto &blk = blocks[b];
+        size_t i = (size_t)(lowerBound(blk, e) - blk.begin());
+        if (i > 0) return &blk[i - 1];
+        return b > 0 ? &blocks[b - 1].back() : nullptr;
+    }
+
+    const RankEntry *after(const RankEntry &e) const {
+        size_t b = blockFor(e);
+        const auto &blk = blocks[b];
+        size_t i = (size_t)(lowerBound(blk, e) - blk.begin());
+        if (i + 1 < blk.size()) return &blk[i + 1];
+        return b + 1 < blocks.size() ? &blocks[b + 1].front() : nullptr;
+    }
+
+    // Key comparisons made so far, for RuntimeStats
+    uint64_t comparisons() const { return compareCount; }
+
+    template <class F>
+    void forEach(F f) const {
+        for (const auto &blk : blocks) {
+            for (const RankEntry &e : blk) f(e);
+        }
+    }
+
+private:
+    static constexpr size_t kBlock = 64;
+
+    bool less(const RankEntry &a, const RankEntry &b) const {
+        ++compareCount;
+        if (a.head != b.head) return a.head < b.head;
+        return PackedRankKey::less<W>(keys + (size_t)a.team * W, keys + (size_t)b.team * W);
+    }
+
+    vector<RankEntry>::const_iterator lowerBound(const vector<RankEntry> &blk, const RankEntry &e) const {
+        return lower_bound(blk.begin(), blk.end(), e, [&](const RankEntry &x, const RankEntry &y){ return less(x, y); });
+    }
+
+    // First block whose last entry is not below e (blocks.size() if none)
+    size_t blockFor(const RankEntry &e) const {
+        return (size_t)(partition_point(blocks.begin(), blocks.end(),
+                                        [&](const vector<RankEntry> &blk){ return less(blk.back(), e); })
+                        - blocks.begin());
+    }
+
+    const uint64_t *keys;
+    vector<vector<RankEntry>> blocks;
+    mutable uint64_t compareCount = 0;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Opt-in runtime statistics: per-command latency (steady_clock, log2
+// histograms) and engine counters. Nothing is recorded unless a RuntimeStats
+// is attached, so the disabled cost is a null-pointer test per hook.
+
+enum class CommandKind : uint8_t {
+    AddTeam,
+    Start,
+    Submit,
+    Flush,
+    Freeze,
+    Scroll,
+    QueryRanking,
+    QuerySubmission,
+    QueryLiveRanking,
+    Print,
+    Stats,
+    End,
+    Other
+};
+
+constexpr int kCommandKinds = 13;
+
+inline const char *commandKindName(CommandKind k) {
+    static const char *const names[kCommandKinds] = {
+        "ADDTEAM", "START", "SUBMIT", "FLUSH", "FREEZE", "SCROLL",
+        "QUERY_RANKING", "QUERY_SUBMISSION", "QUERY_LIVE_RANKING", "PRINT", "STATS", "END", "(other)"
+    };
+    return names[(int)k];
+}
+
+inline CommandKind commandKindOf(string_view cmd) {
+    for (int k = 0; k < kCommandKinds - 1; ++k) {
+        if (cmd == commandKindName((CommandKind)k)) return (CommandKind)k;
+    }
+    return CommandKind::Other;
+}
+
+struct RuntimeStats {
+    // Bucket b holds latencies in [2^(b-1), 2^b) ns; bucket 0 is 0 ns
+    static constexpr int kBuckets = 40;
+
+    struct CommandStats {
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+        uint64_t histogram[kBuckets] = {};
+    };
+
+    CommandStats commands[kCommandKinds];
+    uint64_t keyRebuilds = 0; // rank keys recomputed by FLUSH and SCROLL
+    atomic<uint64_t> comparatorCalls{0}; // rank comparisons, also from pool threads
+    uint64_t scrollUnfreezes = 0; // problems revealed one at a time by SCROLL
+
+    void record(CommandKind k, uint64_t ns) {
+        CommandStats &c = commands[(int)k];
+        ++c.count;
+        c.totalNs += ns;
+        c.maxNs = max(c.maxNs, ns);
+        ++c.histogram[bucketOf(ns)];
+    }
+
+    // count commands applied together in ns; each is charged the mean
+    void recordBatch(CommandKind k, uint64_t count, uint64_t ns) {
+        if (!count) return;
+        CommandStats &c = commands[(int)k];
+        uint64_t each = ns / count;
+        c.count += count;
+        c.totalNs += ns;
+        c.maxNs = max(c.maxNs, each);
+        c.histogram[bucketOf(each)] += count;
+    }
+
+    static int bucketOf(uint64_t ns) { return ns ? min(kBuckets - 1, 64 - __builtin_clzll(ns)) : 0; }
+
+    // Upper latency bound (ns) under which a fraction q of the commands fall;
+    // never above the slowest one seen, which is all that bounds the last bucket
+    static uint64_t bucketQuantile(const CommandStats &c, double q) {
+        uint64_t need = (uint64_t)ceil(q * c.count), seen = 0;
+        for (int b = 0; b < kBuckets; ++b) {
+            seen += c.histogram[b];
+            if (seen < need || !seen) continue;
+            if (b == 0) return 0;
+            return b == kBuckets - 1 ? c.maxNs : min<uint64_t>(1ULL << b, c.maxNs);
+        }
+        return c.maxNs;
+    }
+
+    static string formatNs(uint64_t ns) {
+        char buf[32];
+        if (ns < 10000) snprintf(buf, sizeof buf, "%lluns", (unsigned long long)ns);
+        else if (ns < 1000000) snprintf(buf, sizeof buf, "%.1fus", ns / 1e3);
+        else snprintf(buf, sizeof buf, "%.2fms", ns / 1e6);
+        return buf;
+    }
+
+    // rows / rowBytes: the contest's latest-submission rows in use and the
+    // bytes reserved for them
+    void dump(FILE *f, uint64_t bytesWritten, uint64_t rows, uint64_t rowBytes) const {
+        fprintf(f, "[Stats]%-17s %10s %12s %10s %10s %10s %10s\n", "command", "count", "total ms",
+                "mean", "p50<=", "p99<=", "max");
+        for (int k = 0; k < kCommandKinds; ++k) {
+            const CommandStats &c = commands[k];
+            if (!c.count) continue;
+            fprintf(f, "[Stats]%-17s %10llu %12.3f %10s %10s %10s %10s\n", commandKindName((CommandKind)k),
+                    (unsigned long long)c.count, c.totalNs / 1e6, formatNs(c.totalNs / c.count).c_str(),
+                    formatNs(bucketQuantile(c, 0.5)).c_str(), formatNs(bucketQuantile(c, 0.99)).c_str(),
+                    formatNs(c.maxNs).c_str());
+            // non-empty buckets as "<upper bound>:count"
+            fprintf(f, "[Stats]  histogram");
+            for (int b = 0; b < kBuckets; ++b) {
+                if (c.histogram[b]) {
+                    fprintf(f, " <%s:%llu", formatNs(1ULL << b).c_str(), (unsigned long long)c.histogram[b]);
+                }
+            }
+            fputc('\n', f);
+        }
+        fprintf(f, "[Stats]rank key rebuilds %llu, comparator calls %llu, scroll unfreezes %llu, bytes written %llu\n",
+                (unsigned long long)keyRebuilds, (unsigned long long)comparatorCalls.load(memory_order_relaxed),
+                (unsigned long long)scrollUnfreezes, (unsigned long long)bytesWritten);
+        fprintf(f, "[Stats]submission rows %llu, %llu bytes reserved\n", (unsigned long long)rows,
+                (unsigned long long)rowBytes);
+        fflush(f);
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <bits/stdc++.h>
+#include "contest_types.h"
+using namespace std;
+
+// A run of SUBMITs between other commands, applied team by team. Teams do
+// not affect each other's state, so only each team's own order matters: a
+// stable LSD radix sort on the team id keeps it, and every team's columns
+// and query table are then visited once per run instead of once per submit.
+class SubmitBatch {
+public:
+    static constexpr size_t kCapacity = 1 << 16; // apply() once this many are pending
+
+    bool empty() const { return pending.empty(); }
+    size_t size() const { return pending.size(); }
+    bool full() const { return pending.size() >= kCapacity; }
+
+    void add(int ti, int p, JudgeStatus st, int time) {
+        pending.push_back(Pending{ti, p, st, time});
+    }
+
+    // Applies every pending submit and empties the batch: applyOne(ti, p,
+    // st, time) does the work in per-team order, and prefetch(ti, p) runs a
+    // few submits ahead of it so the team's state is in cache on arrival
+    template <class Apply, class Prefetch>
+    void apply(int teamCount, Apply applyOne, Prefetch prefetch) {
+        if (pending.size() >= kMinSorted) sortByTeam(teamCount);
+        size_t n = pending.size();
+        for (size_t i = 0; i < min(n, kPrefetchDistance); ++i) prefetch(pending[i].team, pending[i].problem);
+        for (size_t i = 0; i < n; ++i) {
+            if (i + kPrefetchDistance < n) {
+                const Pending &ahead = pending[i + kPrefetchDistance];
+                prefetch(ahead.team, ahead.problem);
+            }
+            const Pending &s = pending[i];
+            applyOne(s.team, s.problem, s.status, s.time);
+        }
+        pending.clear();
+    }
+
+private:
+    static constexpr size_t kMinSorted = 256; // shorter runs gain nothing from sorting
+    static constexpr int kDigitBits = 11;
+    static constexpr size_t kPrefetchDistance = 8;
+
+    struct Pending {
+        int team;
+        int problem;
+        JudgeStatus status;
+        int time;
+    };
+
+    void sortByTeam(int teamCount) {
+        int bits = 32 - __builtin_clz((unsigned)max(teamCount - 1, 1));
+        sorted.resize(pending.size());
+        for (int shift = 0; shift < bits; shift += kDigitBits) {
+            uint32_t count[(1 << kDigitBits) + 1] = {};
+            for (const Pending &s : pending) ++count[((unsigned)s.team >> shift & ((1 << kDigitBits) - 1)) + 1];
+            for (int d = 0; d < (1 << kDigitBits); ++d) count[d + 1] += count[d];
+            for (const Pending &s : pending) sorted[count[(unsigned)s.team >> shift & ((1 << kDigitBits) - 1)]++] = s;
+            pending.swap(sorted);
+        }
+    }
+
+    vector<Pending> pending, sorted;
+};
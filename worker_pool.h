@@ -0,0 +1,120 @@
+#pragma once
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Fixed set of worker threads for data-parallel loops. The calling thread
+// takes part in every loop, so a pool of size 1 runs everything inline.
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads) {
+        for (int i = 1; i < threads; ++i) workers.emplace_back([this]{ workerLoop(); });
+    }
+
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> lk(mu);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : workers) t.join();
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int size() const { return (int)workers.size() + 1; }
+
+    // Calls f(begin, end) on disjoint pieces of [0, n), each at least grain
+    // items long unless n itself is smaller
+    template <class F>
+    void parallelFor(size_t n, size_t grain, F f) {
+        size_t pieces = min((n + grain - 1) / max<size_t>(grain, 1), (size_t)size() * 4);
+        if (pieces <= 1) {
+            if (n) f(0, n);
+            return;
+        }
+        size_t step = (n + pieces - 1) / pieces;
+        pieces = (n + step - 1) / step;
+        function<void(size_t)> task = [&](size_t i){ f(i * step, min(n, (i + 1) * step)); };
+        run(pieces, task);
+    }
+
+    // Merge sort: one std::sort run per thread, then rounds of pairwise merges
+    template <class Vec, class Less>
+    void sort(Vec &v, Less less) {
+        size_t n = v.size();
+        size_t runs = (size_t)size();
+        if (runs == 1 || n < kMinParallelSort) {
+            std::sort(v.begin(), v.end(), less);
+            return;
+        }
+        size_t width = (n + runs - 1) / runs;
+        parallelFor(runs, 1, [&](size_t b, size_t e){
+            for (size_t r = b; r < e; ++r) {
+                size_t lo = min(n, r * width), hi = min(n, lo + width);
+                std::sort(v.begin() + lo, v.begin() + hi, less);
+            }
+        });
+        Vec tmp(n, typename Vec::value_type(), v.get_allocator());
+        for (; width < n; width *= 2) {
+            size_t pairs = (n + 2 * width - 1) / (2 * width);
+            parallelFor(pairs, 1, [&](size_t b, size_t e){
+                for (size_t i = b; i < e; ++i) {
+                    size_t lo = i * 2 * width, mid = min(n, lo + width), hi = min(n, lo + 2 * width);
+                    merge(v.begin() + lo, v.begin() + mid, v.begin() + mid, v.begin() + hi, tmp.begin() + lo, less);
+                }
+            });
+            v.swap(tmp);
+        }
+    }
+
+private:
+    static constexpr size_t kMinParallelSort = 1 << 14;
+
+    // Runs task(0 .. tasks-1) across the pool and returns once all are done
+    void run(size_t tasks, const function<void(size_t)> &task) {
+        {
+            lock_guard<mutex> lk(mu);
+            job = &task;
+            jobTasks = tasks;
+            nextTask = 0;
+            ++generation;
+        }
+        wake.notify_all();
+        drain();
+        unique_lock<mutex> lk(mu);
+        idle.wait(lk, [&]{ return busy == 0; });
+        job = nullptr;
+    }
+
+    void drain() {
+        for (size_t t; (t = nextTask.fetch_add(1)) < jobTasks;) (*job)(t);
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                unique_lock<mutex> lk(mu);
+                wake.wait(lk, [&]{ return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                ++busy;
+            }
+            drain();
+            lock_guard<mutex> lk(mu);
+            if (--busy == 0) idle.notify_one();
+        }
+    }
+
+    vector<thread> workers;
+    mutex mu;
+    condition_variable wake, idle;
+    bool stopping = false;
+    uint64_t generation = 0;
+    int busy = 0; // workers inside drain(); run() waits for them to leave
+    const function<void(size_t)> *job = nullptr;
+    size_t jobTasks = 0;
+    atomic<size_t> nextTask{0};
+};